@@ -20,7 +20,7 @@ typedef long long Time;                  // Nanoseconds
 static const Time TIME_UNDEFINED = -1;
 #endif
 
-static struct
+static __thread struct
 {
     int started;
     Time startTime;
@@ -32,6 +32,12 @@ static struct
     double timePerMs;
 } control = {0};
 
+typedef struct
+{
+    Time elapsedFrameTime;
+    unsigned long frameCount;
+} FrameControlState;
+
 
 static inline double timeToMs( Time time )
 {
@@ -142,3 +148,40 @@ double getCurrentFps()
 {
     return control.frameCount / (timeToMs(control.prevFrameTime - control.startTime) / 1000.0);
 }
+
+int getFrameControlStateSize()
+{
+    return sizeof(FrameControlState);
+}
+
+void saveFrameControlState( void* state )
+{
+    FrameControlState* s = (FrameControlState*)state;
+    s->elapsedFrameTime = control.elapsedFrameTime;
+    s->frameCount = control.frameCount;
+}
+
+// Starts the frame clock from 0 without starting the frame control, for the
+// game instances which are stepped without rendering
+void resetFrameClock()
+{
+    control.elapsedFrameTime = 0;
+    control.frameCount = 0;
+}
+
+// Advances the frame clock by the given time without waiting
+void advanceFrameClock( double ms )
+{
+    if (control.timePerMs == 0) {
+        control.timePerMs = 1000000; // Any unit works, as the time is not compared to the real one
+    }
+    control.elapsedFrameTime = msToTime(ms);
+    control.frameCount += 1;
+}
+
+void restoreFrameControlState( const void* state )
+{
+    const FrameControlState* s = (const FrameControlState*)state;
+    control.elapsedFrameTime = s->elapsedFrameTime;
+    control.frameCount = s->frameCount;
+}
@@ -14,4 +14,13 @@ double getElapsedFrameTime(); // ms
 double getElapsedTime();      // ms
 double getCurrentFps();
 
+// The frame clock (elapsed frame time and frame count) can be saved with the
+// game state. The real time is not saved, so the restored clock continues from
+// the current time.
+int getFrameControlStateSize();
+void saveFrameControlState( void* state );
+void restoreFrameControlState( const void* state );
+void resetFrameClock();
+void advanceFrameClock( double ms );
+
 #endif
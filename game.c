@@ -9,8 +9,20 @@
 #include "helpers.h"
 #include "render.h"
 #include "levels.h"
+#include "rewind.h"
+#include "instance.h"
+#include "particles.h"
+#include "latency.h"
+#include "memory.h"
+#include "timerwheel.h"
+#include "minimap.h"
+#include "hotreload.h"
+#include "pack.h"
+#include "trace.h"
 #include "SDL_ttf.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 typedef enum
@@ -22,49 +34,70 @@ typedef enum
     STATE_LEVELCOMPLETE
 } GAME_STATE;
 
-static struct {
+typedef struct {
     GAME_STATE state;
     const Uint8* keystate;
-    struct { double x, y; } respawnPos;
-    double cleanTime;
+    struct { Fixed x, y; } respawnPos;
     int jumpDenied;
-} game;
+    Uint32 seed;
+    Uint32 tickCount;
+    Uint32 nextObjectId;
+} GameState;
 
-Level* level = 0;
-Player player;
+static __thread GameState game;
 
-static const double PLAYER_SPEED_RUN = 72;          // Pixels per second 
-static const double PLAYER_SPEED_LADDER = 48;       //
-static const double PLAYER_SPEED_JUMP = 216;        //
-static const double PLAYER_SPEED_FALL_MAX = 120;    //
+// The game state is per thread, see instance.h
+__thread Level* level = 0;
+__thread Player* player = 0;
 
-static const double PLAYER_GRAVITY = 24 * 48;       // Pixels per second per second
+static int rewinding = 0;   // Not in game, because it's not a part of the game state
+
+// Plays instead of the keyboard (see getAutopilotInput()), and starts a new
+// game when the current one is over
+static struct
+{
+    int enabled;
+    Uint32 random;
+    int hold;               // Ticks left to hold the input
+} autopilot;
+
+static const Fixed PLAYER_SPEED_RUN = FIXED(72);           // Pixels per second 
+static const Fixed PLAYER_SPEED_LADDER = FIXED(48);        //
+static const Fixed PLAYER_SPEED_JUMP = FIXED(216);         //
+static const Fixed PLAYER_SPEED_FALL_MAX = FIXED(120);     //
+
+static const Fixed PLAYER_GRAVITY = FIXED(24 * 48);        // Pixels per second per second
 
 static const double PLAYER_ANIM_SPEED_RUN = 8;      // Frames per second
 static const double PLAYER_ANIM_SPEED_LADDER = 6;   //
 
-static const double CLEAN_PERIOD = 10000;           // Milliseconds
+static const Uint32 WORLD_SEED = 1;                 // Default
+
+static const SDL_Scancode REWIND_KEY = SDL_SCANCODE_BACKSPACE;
+static const int REWIND_SPEED = 2;                  // Ticks per frame
+static const SDL_Scancode MEMORY_DUMP_KEY = SDL_SCANCODE_F10;
+static const SDL_Scancode MINIMAP_KEY = SDL_SCANCODE_M;
 
 
 void damagePlayer( int damage )
 {
-    if (player.invincibility > 0) {
+    if (player->invincibility > 0) {
         return;
     }
-    player.health -= damage;
-    if (player.health <= 0) {
-        player.health = 0;
+    player->health -= damage;
+    if (player->health <= 0) {
+        player->health = 0;
         killPlayer();
     }
 }
 
 void killPlayer()
 {
-    if (player.invincibility > 0) {
+    if (player->invincibility > 0) {
         return;
     }
-    setAnimation((Object*)&player, 5, 5, 0);
-    if (-- player.lives) {
+    setAnimation((Object*)player, 5, 5, 0);
+    if (-- player->lives) {
         game.state = STATE_KILLED;
     } else {
         game.state = STATE_GAMEOVER;
@@ -73,20 +106,18 @@ void killPlayer()
 
 void respawnPlayer()
 {
-    setAnimation((Object*)&player, 0, 0, 0);
-    player.invincibility = 2000;
-    player.onLadder = 0;
-    player.inAir = 0;
-    player.x = game.respawnPos.x;
-    player.y = game.respawnPos.y;
+    setAnimation((Object*)player, 0, 0, 0);
+    player->invincibility = 2000;
+    player->onLadder = 0;
+    player->inAir = 0;
+    player->x = game.respawnPos.x;
+    player->y = game.respawnPos.y;
 }
 
 void setLevel( int r, int c )
 {
     level = &levels[r][c];
-    if (level->init) {
-        level->init();
-    }
+    clearParticles();
 }
 
 void completeLevel()
@@ -94,78 +125,138 @@ void completeLevel()
     game.state = STATE_LEVELCOMPLETE;
 }
 
+int getGameStateSize()
+{
+    return sizeof(game);
+}
+
+void saveGameState( void* state )
+{
+    memcpy(state, &game, sizeof(game));
+    ((GameState*)state)->keystate = NULL;
+}
+
+// The keyboard state is owned by SDL, so it's kept
+void restoreGameState( const void* state )
+{
+    const Uint8* keystate = game.keystate;
+    memcpy(&game, state, sizeof(game));
+    game.keystate = keystate;
+}
+
+void resetGameState()
+{
+    game.state = STATE_PLAYING;
+    game.respawnPos.x = 0;
+    game.respawnPos.y = 0;
+    game.jumpDenied = 0;
+    game.seed = WORLD_SEED;
+    game.tickCount = 0;
+    game.nextObjectId = 1;
+}
+
+void setWorldSeed( Uint32 seed )
+{
+    game.seed = seed;
+}
+
+Uint32 getWorldSeed()
+{
+    return game.seed;
+}
+
+Uint32 getTickCount()
+{
+    return game.tickCount;
+}
+
+Uint32 newObjectId()
+{
+    return game.nextObjectId ++;
+}
+
+void setKeyState( const Uint8* keystate )
+{
+    game.keystate = keystate;
+}
+
+int isGameRunning()
+{
+    return game.state != STATE_QUIT;
+}
+
 static void processInput()
 {
     // ... Left
     if (game.keystate[SDL_SCANCODE_LEFT]) {
-        if (!player.onLadder) {
-            if (!player.inAir) {
-                setAnimation((Object*)&player, 1, 2, PLAYER_ANIM_SPEED_RUN);
+        if (!player->onLadder) {
+            if (!player->inAir) {
+                setAnimation((Object*)player, 1, 2, PLAYER_ANIM_SPEED_RUN);
             } else {
-                setAnimation((Object*)&player, 1, 1, PLAYER_ANIM_SPEED_RUN);
+                setAnimation((Object*)player, 1, 1, PLAYER_ANIM_SPEED_RUN);
             }
         }
-        player.anim.flip = SDL_FLIP_HORIZONTAL;
-        player.vx = -PLAYER_SPEED_RUN;
+        player->anim.flip = SDL_FLIP_HORIZONTAL;
+        player->vx = -PLAYER_SPEED_RUN;
 
     // ... Right
     } else if (game.keystate[SDL_SCANCODE_RIGHT]) {
-        if (!player.onLadder) {
-            if (!player.inAir) {
-                setAnimation((Object*)&player, 1, 2, PLAYER_ANIM_SPEED_RUN);
+        if (!player->onLadder) {
+            if (!player->inAir) {
+                setAnimation((Object*)player, 1, 2, PLAYER_ANIM_SPEED_RUN);
             } else {
-                setAnimation((Object*)&player, 1, 1, PLAYER_ANIM_SPEED_RUN);
+                setAnimation((Object*)player, 1, 1, PLAYER_ANIM_SPEED_RUN);
             }
         }
-        player.anim.flip = SDL_FLIP_NONE;
-        player.vx = PLAYER_SPEED_RUN;
+        player->anim.flip = SDL_FLIP_NONE;
+        player->vx = PLAYER_SPEED_RUN;
 
     // ... Not left or right
     } else {
-        if (!player.onLadder) {
-            setAnimation((Object*)&player, 0, 0, 0);
+        if (!player->onLadder) {
+            setAnimation((Object*)player, 0, 0, 0);
         }
-        player.vx = 0;
+        player->vx = 0;
     }
 
     // ... Up
     if (game.keystate[SDL_SCANCODE_UP]) {
         int r, c;
-        getObjectCell((Object*)&player, &r, &c);
+        getObjectCell((Object*)player, &r, &c);
         if (!isLadder(r, c)) {
-            player.onLadder = 0;
+            player->onLadder = 0;
             // jumpDenied prevents jump when player reaches the top of the ladder
             // by holding UP key, until this key is released
-            if (!player.inAir && !game.jumpDenied) {
-                player.vy = -PLAYER_SPEED_JUMP;
+            if (!player->inAir && !game.jumpDenied) {
+                player->vy = -PLAYER_SPEED_JUMP;
             }
         } else {
-            player.onLadder = 1;
-            player.vy = -PLAYER_SPEED_LADDER;
-            player.x = c * CELL_SIZE;
-            setAnimationFlip((Object*)&player, 3, PLAYER_ANIM_SPEED_LADDER);
+            player->onLadder = 1;
+            player->vy = -PLAYER_SPEED_LADDER;
+            player->x = intToFixed(c * CELL_SIZE);
+            setAnimationFlip((Object*)player, 3, PLAYER_ANIM_SPEED_LADDER);
             game.jumpDenied = 1;
         }
 
     // ... Down
     } else if (game.keystate[SDL_SCANCODE_DOWN]) {
         int r, c;
-        getObjectCell((Object*)&player, &r, &c);
-        if (isLadder(r + 1, c) || player.onLadder) {
-            if (!player.onLadder) {
-                player.onLadder = 1;
-                player.y = r * CELL_SIZE + CELL_HALF + 1;
+        getObjectCell((Object*)player, &r, &c);
+        if (isLadder(r + 1, c) || player->onLadder) {
+            if (!player->onLadder) {
+                player->onLadder = 1;
+                player->y = intToFixed(r * CELL_SIZE + CELL_HALF + 1);
             }
-            player.vy = PLAYER_SPEED_LADDER;
-            player.x = c * CELL_SIZE;
-            setAnimationFlip((Object*)&player, 3, PLAYER_ANIM_SPEED_LADDER);
+            player->vy = PLAYER_SPEED_LADDER;
+            player->x = intToFixed(c * CELL_SIZE);
+            setAnimationFlip((Object*)player, 3, PLAYER_ANIM_SPEED_LADDER);
         }
 
     // ... Not up or down
     } else {
-        if (player.onLadder) {
-            setAnimation((Object*)&player, 3, 3, 0);
-            player.vy = 0;
+        if (player->onLadder) {
+            setAnimation((Object*)player, 3, 3, 0);
+            player->vy = 0;
         } else {
             game.jumpDenied = 0;
         }
@@ -174,11 +265,11 @@ static void processInput()
     // ... Space
     if (game.keystate[SDL_SCANCODE_SPACE]) {
         int r, c;
-        getObjectCell((Object*)&player, &r, &c);
+        getObjectCell((Object*)player, &r, &c);
         if (findNearDoor(&r, &c)) {
-            if (player.keys > 0) {
-                player.keys -= 1;
-                level->cells[r][c] = &objectTypes[TYPE_NONE];
+            if (player->keys > 0) {
+                player->keys -= 1;
+                createStaticObject(level, TYPE_NONE, r, c);
             }
         }
     }
@@ -194,143 +285,163 @@ static void processInput()
 static void processPlayer()
 {
     // Movement
-    const double dt = getElapsedFrameTime() / 1000.0;
-    const double hitw = (CELL_SIZE - player.type->body.w) / 2;
-    const double hith = hitw;
+    const Fixed dt = getElapsedFrameSeconds();
+    const Fixed hitw = intToFixed((CELL_SIZE - player->type->body.w) / 2);
+    const Fixed hith = hitw;
 
     int r, c; Borders cell, body;
-    getObjectPos((Object*)&player, &r, &c, &cell, &body);
+    getObjectPos((Object*)player, &r, &c, &cell, &body);
 
-    player.vx = limitAbs(player.vx, MAX_SPEED);
-    player.vy = limitAbs(player.vy, MAX_SPEED);
+    // Each cell border crossed by the sprite is checked, so the player can't
+    // pass through the walls at any speed
 
     // ... X
-    player.x += player.vx * dt;
-    Borders sprite = {player.x, player.x + CELL_SIZE, player.y, player.y + CELL_SIZE};
+    player->x += fixedMul(player->vx, dt);
+    Borders sprite = {player->x, player->x + intToFixed(CELL_SIZE), player->y, player->y + intToFixed(CELL_SIZE)};
 
     // ... Left
-    if (sprite.left < cell.left && player.vx <= 0) {
-        if (isSolid(r, c - 1, SOLID_RIGHT) ||
-            (sprite.top + hith < cell.top && isSolid(r - 1, c - 1, SOLID_RIGHT)) ||
-            (sprite.bottom - hith > cell.bottom && isSolid(r + 1, c - 1, SOLID_RIGHT)) ) {
-            player.x = cell.left;
-            player.vx = 0;
+    if (sprite.left < cell.left && player->vx <= 0) {
+        for (int k = c; sprite.left < intToFixed(CELL_SIZE * k) && k > 0; -- k) {
+            if (isSolid(r, k - 1, SOLID_RIGHT) ||
+                (sprite.top + hith < cell.top && isSolid(r - 1, k - 1, SOLID_RIGHT)) ||
+                (sprite.bottom - hith > cell.bottom && isSolid(r + 1, k - 1, SOLID_RIGHT)) ) {
+                player->x = intToFixed(CELL_SIZE * k);
+                player->vx = 0;
+                break;
+            }
         }
     // ... Right
-    } else if (sprite.right > cell.right && player.vx >= 0) {
-        if (isSolid(r, c + 1, SOLID_LEFT) ||
-            (sprite.top + hith < cell.top && isSolid(r - 1, c + 1, SOLID_LEFT)) ||
-            (sprite.bottom - hith > cell.bottom && isSolid(r + 1, c + 1, SOLID_LEFT)) ) {
-            player.x = cell.left;
-            player.vx = 0;
+    } else if (sprite.right > cell.right && player->vx >= 0) {
+        for (int k = c; sprite.right > intToFixed(CELL_SIZE * (k + 1)) && k < level->columns - 1; ++ k) {
+            if (isSolid(r, k + 1, SOLID_LEFT) ||
+                (sprite.top + hith < cell.top && isSolid(r - 1, k + 1, SOLID_LEFT)) ||
+                (sprite.bottom - hith > cell.bottom && isSolid(r + 1, k + 1, SOLID_LEFT)) ) {
+                player->x = intToFixed(CELL_SIZE * k);
+                player->vx = 0;
+                break;
+            }
         }
     }
 
-    // ... Y
-    player.y += player.vy * dt;
-    sprite = (Borders){player.x, player.x + CELL_SIZE, player.y, player.y + CELL_SIZE};
+    // ... Y, in the column reached by the X movement
+    getObjectPos((Object*)player, &r, &c, &cell, &body);
+    player->y += fixedMul(player->vy, dt);
+    sprite = (Borders){player->x, player->x + intToFixed(CELL_SIZE), player->y, player->y + intToFixed(CELL_SIZE)};
 
     // ... Bottom
-    if (sprite.bottom > cell.bottom && player.vy >= 0) {
-        if (isSolid(r + 1, c, SOLID_TOP) ||
-            (sprite.left + hitw < cell.left && isSolid(r + 1, c - 1, SOLID_TOP)) ||
-            (sprite.right - hitw > cell.right && isSolid(r + 1, c + 1, SOLID_TOP)) ||
-            (!player.onLadder && isSolidLadder(r + 1, c)) ) {
-            player.y = cell.top;
-            player.vy = 0;
-            player.inAir = 0;
-            if (player.onLadder) {
-                player.onLadder = 0;
-                setAnimation((Object*)&player, 0, 0, 0);
+    if (sprite.bottom > cell.bottom && player->vy >= 0) {
+        player->inAir = !player->onLadder;
+        for (int k = r; sprite.bottom > intToFixed(CELL_SIZE * (k + 1)) && k < level->rows - 1; ++ k) {
+            if (isSolid(k + 1, c, SOLID_TOP) ||
+                (sprite.left + hitw < cell.left && isSolid(k + 1, c - 1, SOLID_TOP)) ||
+                (sprite.right - hitw > cell.right && isSolid(k + 1, c + 1, SOLID_TOP)) ||
+                (!player->onLadder && isSolidLadder(k + 1, c)) ) {
+                player->y = intToFixed(CELL_SIZE * k);
+                player->vy = 0;
+                player->inAir = 0;
+                if (player->onLadder) {
+                    player->onLadder = 0;
+                    setAnimation((Object*)player, 0, 0, 0);
+                }
+                break;
             }
-        } else {
-            player.inAir = !player.onLadder;
         }
     // ... Top
-    } else if (sprite.top < cell.top && player.vy <= 0) {
-        if (isSolid(r - 1, c, SOLID_BOTTOM) ||
-            (sprite.left + hitw < cell.left && isSolid(r - 1, c - 1, SOLID_BOTTOM)) ||
-            (sprite.right - hitw > cell.right && isSolid(r - 1, c + 1, SOLID_BOTTOM)) ) {
-            player.y = cell.top;
-            player.vy += 1;
+    } else if (sprite.top < cell.top && player->vy <= 0) {
+        for (int k = r; sprite.top < intToFixed(CELL_SIZE * k) && k > 0; -- k) {
+            if (isSolid(k - 1, c, SOLID_BOTTOM) ||
+                (sprite.left + hitw < cell.left && isSolid(k - 1, c - 1, SOLID_BOTTOM)) ||
+                (sprite.right - hitw > cell.right && isSolid(k - 1, c + 1, SOLID_BOTTOM)) ) {
+                player->y = intToFixed(CELL_SIZE * k);
+                player->vy += FIXED_ONE;
+                break;
+            }
         }
-        player.inAir = !player.onLadder;
+        player->inAir = !player->onLadder;
     }
 
-    // Screen borders
-    getObjectCell((Object*)&player, &r, &c);
+    // Level borders. The levels in a row have the same height, and the levels
+    // in a column have the same width, so the row or column is kept.
+    getObjectCell((Object*)player, &r, &c);
+    r = r < 0 ? 0 : r >= level->rows ? level->rows - 1 : r;
+    c = c < 0 ? 0 : c >= level->columns ? level->columns - 1 : c;
 
     const int lc = level->c;
     const int lr = level->r;
+    const int width = level->columns * CELL_SIZE;
+    const int height = level->rows * CELL_SIZE;
 
     // ... Left
-    if (player.x < 0) {
-        if (lc > 0 && !levels[lr][lc - 1].cells[r][COLUMN_COUNT - 1]->solid) {
-            if (player.x + CELL_HALF < 0) {
+    if (player->x < 0) {
+        const Level* next = lc > 0 ? &levels[lr][lc - 1] : NULL;
+        if (next && !getCell(next, r, next->columns - 1)->solid) {
+            if (player->x + intToFixed(CELL_HALF) < 0) {
                 setLevel(lr, lc - 1);
-                player.x = LEVEL_WIDTH - CELL_HALF - 1;
+                player->x = intToFixed(next->columns * CELL_SIZE - CELL_HALF - 1);
             }
         } else {
-            player.x = 0;
+            player->x = 0;
         }
     // ... Right
-    } else if (player.x + CELL_SIZE > LEVEL_WIDTH) {
-        if (lc < LEVEL_COUNTX - 1 && !levels[lr][lc + 1].cells[r][0]->solid) {
-            if (player.x + CELL_HALF > LEVEL_WIDTH) {
+    } else if (player->x + intToFixed(CELL_SIZE) > intToFixed(width)) {
+        const Level* next = lc < LEVEL_COUNTX - 1 ? &levels[lr][lc + 1] : NULL;
+        if (next && !getCell(next, r, 0)->solid) {
+            if (player->x + intToFixed(CELL_HALF) > intToFixed(width)) {
                 setLevel(lr, lc + 1);
-                player.x = -CELL_HALF + 1;
+                player->x = intToFixed(-CELL_HALF + 1);
             }
         } else {
-            player.x = LEVEL_WIDTH - CELL_SIZE;
+            player->x = intToFixed(width - CELL_SIZE);
         }
     }
     // ... Bottom
-    if (player.y + player.type->body.h > LEVEL_HEIGHT) {
+    if (player->y + intToFixed(player->type->body.h) > intToFixed(height)) {
         if (lr < LEVEL_COUNTY - 1) {
-            if (!levels[lr + 1][lc].cells[0][c]->solid) {
-                if (player.y + player.type->body.h / 2 > LEVEL_HEIGHT) {
+            if (!getCell(&levels[lr + 1][lc], 0, c)->solid) {
+                if (player->y + intToFixed(player->type->body.h / 2) > intToFixed(height)) {
                     setLevel(lr + 1, lc);
-                    player.y = -CELL_HALF + 1;
+                    player->y = intToFixed(-CELL_HALF + 1);
                 }
             } else {
-                player.y = LEVEL_HEIGHT - player.type->body.h;
-                player.inAir = 0;
+                player->y = intToFixed(height - player->type->body.h);
+                player->inAir = 0;
             }
         } else {
             killPlayer();
         }
     // ... Top
-    } else if (player.y < 0) {
-        if (lr > 0 && !levels[lr - 1][lc].cells[ROW_COUNT - 1][c]->solid) {
-            if (player.y + CELL_HALF < 0) {
+    } else if (player->y < 0) {
+        const Level* next = lr > 0 ? &levels[lr - 1][lc] : NULL;
+        if (next && !getCell(next, next->rows - 1, c)->solid) {
+            if (player->y + intToFixed(CELL_HALF) < 0) {
                 setLevel(lr - 1, lc);
-                player.y = LEVEL_HEIGHT - CELL_HALF - 1;
+                player->y = intToFixed(next->rows * CELL_SIZE - CELL_HALF - 1);
             }
         } else if (lr > 0) {
-            player.y = 0;
+            player->y = 0;
         } else {
             // Player will simply fall down
         }
     }
 
     // Environment and others
-    getObjectCell((Object*)&player, &r, &c);
+    getObjectCell((Object*)player, &r, &c);
 
     // ... Gravity
-    if (!player.onLadder) {
-        player.vy += PLAYER_GRAVITY * dt;
-        if (player.vy > PLAYER_SPEED_FALL_MAX) {
-            player.vy = PLAYER_SPEED_FALL_MAX;
+    if (!player->onLadder) {
+        player->vy += fixedMul(PLAYER_GRAVITY, dt);
+        if (player->vy > PLAYER_SPEED_FALL_MAX) {
+            player->vy = PLAYER_SPEED_FALL_MAX;
         }
     }
 
     // ... Ladder
-    if (player.onLadder && !isLadder(r, c)) {
-        player.onLadder = 0;
-        setAnimation((Object*)&player, 0, 0, 0);
-        if (player.vy < 0) {
-            player.vy = 0;
-            player.y = CELL_SIZE * r;
+    if (player->onLadder && !isLadder(r, c)) {
+        player->onLadder = 0;
+        setAnimation((Object*)player, 0, 0, 0);
+        if (player->vy < 0) {
+            player->vy = 0;
+            player->y = intToFixed(CELL_SIZE * r);
         }
     }
 
@@ -340,71 +451,244 @@ static void processPlayer()
     }
 
     // ... Invincibility
-    if (player.invincibility > 0) {
-        player.invincibility -= dt * 1000;
-        if (player.invincibility < 0) {
-            player.invincibility = 0;
+    if (player->invincibility > 0) {
+        player->invincibility -= getElapsedFrameTime();
+        if (player->invincibility < 0) {
+            player->invincibility = 0;
         }
-        player.anim.alpha = 255 * (1 - (player.invincibility / 200) % 2);  // Blink each 200 ms
+        player->anim.alpha = 255 * (1 - (player->invincibility / 200) % 2);  // Blink each 200 ms
     }
 
     // ... If player stands on the ground, remember this position
-    if (!player.inAir && !player.onLadder) {
-        game.respawnPos.x = player.x;
-        game.respawnPos.y = player.y;
+    if (!player->inAir && !player->onLadder) {
+        game.respawnPos.x = player->x;
+        game.respawnPos.y = player->y;
     }
 }
 
-static void processObjects()
+// Sleeping objects
+
+typedef enum
 {
-    for (int i = 0; i < level->objects.count; ++ i) {
-        Object* object = level->objects.array[i];
-        if (object == (Object*)&player || object->removed == 1) {
-            continue;
-        }
-        object->type->onFrame(object);
-        if (hitTest(object, (Object*)&player)) {
-            object->type->onHit(object);
-        }
+    SLEEP_NONE = 0,
+    SLEEP_REQUESTED,
+    SLEEP_ASLEEP,
+    SLEEP_WAKING        // Asleep, and is to be woken in this tick (not in the timer wheel)
+} SleepState;
+
+enum { SLEEP_WAKE_DISTANCE = 2 }; // Cells around the player where the objects are awake
+
+static void getSleeperCell( Object* object, int* r, int* c )
+{
+    getObjectCell(object, r, c);
+    *r = *r < 0 ? 0 : *r >= level->rows ? level->rows - 1 : *r;
+    *c = *c < 0 ? 0 : *c >= level->columns ? level->columns - 1 : *c;
+}
+
+static int isNearPlayer( int r, int c )
+{
+    int pr, pc;
+    getObjectCell((Object*)player, &pr, &pc);
+    return abs(r - pr) <= SLEEP_WAKE_DISTANCE && abs(c - pc) <= SLEEP_WAKE_DISTANCE;
+}
+
+// Links the sleeping object into the level lookups
+static void addSleeper( Level* level, Object* object )
+{
+    int r, c;
+    getSleeperCell(object, &r, &c);
+    Object** sleepers = &getWritableChunk(level, r, c)->sleepers[r & CHUNK_MASK][c & CHUNK_MASK];
+    object->nextSleeper = *sleepers;
+    *sleepers = object;
+    if (object->wakeTime) {
+        TimerWheel_add(&level->timers, object);
     }
 }
 
-static void processFrame()
+// Unlinks the object from its cell and moves it to the awake ones
+static void wakeSleeper( Level* level, Object* object )
 {
-    // Draw screen
-    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
+    int r, c;
+    getSleeperCell(object, &r, &c);
+    Object** link = &getChunk(level, r, c)->sleepers[r & CHUNK_MASK][c & CHUNK_MASK];
+    while (*link != object) {
+        link = &(*link)->nextSleeper;
+    }
+    *link = object->nextSleeper;
+    object->nextSleeper = NULL;
 
-    drawScreen();
+    ObjectLayers_wake(&level->objects, object);
+    if (object->wakeTime) {
+        object->state += level->time - object->sleepTime;
+    }
+    object->sleeping = SLEEP_NONE;
+    object->wakeTime = 0;
+}
 
-    if (game.state == STATE_KILLED) {
-        drawMessage(MESSAGE_PLAYER_KILLED);
+// The object falls asleep after its handlers return, unless the player is near.
+// A sleeping object is not processed until the player comes near, ms pass (if
+// ms > 0) or wakeObject() is called. After a timed sleep, the slept time is
+// added to the object state, as if the object counted it.
+void sleepObject( Object* object, int ms )
+{
+    object->sleeping = SLEEP_REQUESTED;
+    object->wakeTime = ms > 0 ? ms : 0;
+}
 
-    } else if (game.state == STATE_LEVELCOMPLETE) {
-        drawMessage(MESSAGE_LEVEL_COMPLETE);
+// The object must be on the current level
+void wakeObject( Object* object )
+{
+    if (object->sleeping == SLEEP_ASLEEP) {
+        if (object->wakeTime) {
+            TimerWheel_remove(&level->timers, object);
+        }
+        wakeSleeper(level, object);
+    }
+    object->sleeping = SLEEP_NONE;
+    object->wakeTime = 0;
+}
 
-    } else if (game.state == STATE_GAMEOVER) {
-        drawMessage(MESSAGE_GAME_OVER);
+// Rebuilds the sleeping objects lookups from the objects, e.g. after restoring
+// them. The sleeping objects must follow the awake ones in their buckets.
+void resetSleepers( Level* level )
+{
+    for (int i = 0; i < level->chunkRows * level->chunkColumns; ++ i) {
+        if (isChunkAllocated(level->chunks[i])) {
+            memset(level->chunks[i]->sleepers, 0, sizeof(level->chunks[i]->sleepers));
+        }
     }
+    TimerWheel_init(&level->timers, level->time);
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        const ObjectArray* bucket = &level->objects.buckets[t];
+        int awake = 0;
+        for (int i = 0; i < bucket->count; ++ i) {
+            if (bucket->array[i]->sleeping == SLEEP_ASLEEP) {
+                addSleeper(level, bucket->array[i]);
+            } else {
+                awake = i + 1;
+            }
+        }
+        level->objects.awake[t] = awake;
+    }
+}
 
-    SDL_RenderPresent(renderer);
+// The objects are woken in the order of their ids, because the order changes
+// their places in the buckets, and the lookups don't keep any certain order
+static void wakeObjects()
+{
+    ObjectArray* waking = &level->waking;
+    waking->count = 0;
+
+    // ... By timer
+    TimerWheel_advance(&level->timers, level->time, waking);
+    for (int i = 0; i < waking->count; ++ i) {
+        // An object left in the wheel after it's woken would be unlinked twice
+        ensure(waking->array[i]->sleeping == SLEEP_ASLEEP, "wakeObjects(): The timer fired an awake object");
+        waking->array[i]->sleeping = SLEEP_WAKING;
+    }
 
-    // Read all events
-    SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-        if (event.type == SDL_QUIT) {
-            game.state = STATE_QUIT;
+    // ... By the player
+    int pr, pc;
+    getObjectCell((Object*)player, &pr, &pc);
+    for (int r = pr - SLEEP_WAKE_DISTANCE; r <= pr + SLEEP_WAKE_DISTANCE; ++ r) {
+        for (int c = pc - SLEEP_WAKE_DISTANCE; c <= pc + SLEEP_WAKE_DISTANCE; ++ c) {
+            if (!isCellValid(r, c)) {
+                continue;
+            }
+            Object* sleepers = getChunk(level, r, c)->sleepers[r & CHUNK_MASK][c & CHUNK_MASK];
+            for (Object* object = sleepers; object; object = object->nextSleeper) {
+                if (object->sleeping == SLEEP_ASLEEP) {
+                    if (object->wakeTime) {
+                        TimerWheel_remove(&level->timers, object);
+                    }
+                    object->sleeping = SLEEP_WAKING;
+                    ObjectArray_append(waking, object);
+                }
+            }
+        }
+    }
+
+    for (int i = 1; i < waking->count; ++ i) {
+        Object* object = waking->array[i];
+        int j = i;
+        for (; j > 0 && waking->array[j - 1]->id > object->id; -- j) {
+            waking->array[j] = waking->array[j - 1];
+        }
+        waking->array[j] = object;
+    }
+    for (int i = 0; i < waking->count; ++ i) {
+        wakeSleeper(level, waking->array[i]);
+    }
+}
+
+// Processes the awake objects in depth order and drops the removed ones in the
+// same pass. Objects created by the handlers are appended to their buckets and
+// are processed in this pass if their bucket is not passed yet.
+static void processObjects()
+{
+    const int elapsed = getElapsedFrameTime();
+    ObjectLayers* objects = &level->objects;
+    const Uint64 traceStart = beginTrace();
+    wakeObjects();
+    endPhaseTrace("wake", traceStart);
+
+    for (int t = TYPE_COUNT - 1; t >= 0; -- t) {
+        ObjectArray* bucket = &objects->buckets[t];
+        for (int i = 0; i < objects->awake[t];) {
+            Object* object = bucket->array[i];
+            if (object != (Object*)player && !object->removed) {
+                const ObjectTypeId typeId = object->type->typeId;
+                Uint64 traceStart = beginTrace();
+                object->type->onFrame(object);
+                endHandlerTrace(TRACE_ON_FRAME, typeId, traceStart);
+                if (hitTest(object, (Object*)player)) {
+                    traceStart = beginTrace();
+                    object->type->onHit(object);
+                    endHandlerTrace(TRACE_ON_HIT, typeId, traceStart);
+                }
+                updateObjectChunk(level, object);
+            }
+            // The last awake object is moved to i, so it will be processed next
+            if (object->removed) {
+                removeObjectChunk(object);
+                ObjectLayers_removeAt(objects, t, i);
+                releaseObject(object);
+            } else if (object->sleeping == SLEEP_REQUESTED) {
+                int r, c;
+                getSleeperCell(object, &r, &c);
+                if (isNearPlayer(r, c)) {
+                    object->sleeping = SLEEP_NONE;
+                    object->wakeTime = 0;
+                    ++ i;
+                } else {
+                    // The sleep starts after this tick, which the object has counted
+                    object->sleeping = SLEEP_ASLEEP;
+                    object->sleepTime = level->time + elapsed;
+                    object->wakeTime = object->wakeTime ? object->sleepTime + object->wakeTime : 0;
+                    ObjectLayers_sleepAt(objects, t, i);
+                    addSleeper(level, object);
+                }
+            } else {
+                ++ i;
+            }
         }
     }
 
-    // Process user input and game logic
-    const double current_time = getElapsedTime();
+    level->time += elapsed;
+}
+
+void processTick()
+{
+    game.tickCount += 1;
 
     if (game.state == STATE_PLAYING) {
         processInput();
+        Uint64 traceStart = beginTrace();
         processPlayer();
+        endPhaseTrace("player", traceStart);
+        traceStart = beginTrace();
         processObjects();
+        endPhaseTrace("objects", traceStart);
 
     } else if (game.state == STATE_KILLED) {
         if (game.keystate[SDL_SCANCODE_SPACE]) {
@@ -424,12 +708,120 @@ static void processFrame()
             game.state = STATE_QUIT;
         }
     }
+}
+
+static void printRewindStats()
+{
+    RewindStats stats;
+    getRewindStats(&stats);
+    printf("rewind: %d ticks (%.1f s), %d bytes, %.0f bytes per tick, last step %.1f us\n",
+           stats.ticks, stats.ticks / (double)FRAME_RATE, stats.bytes, stats.bytesPerTick, stats.lastLatency);
+}
+
+void setAutopilot( int enabled )
+{
+    GameInstance* instance = getCurrentInstance();
+    autopilot.enabled = enabled;
+    autopilot.random = 1;
+    autopilot.hold = 0;
+    setInstanceInput(instance, 0);
+    instance->keystate = enabled ? instance->keys : SDL_GetKeyboardState(NULL);
+    setKeyState(instance->keystate);
+}
+
+static void updateAutopilot()
+{
+    if (game.state == STATE_GAMEOVER || game.state == STATE_LEVELCOMPLETE) {
+        GameInstance* finished = getCurrentInstance();
+        GameInstance* instance = createGameInstance();
+        instance->keystate = instance->keys;
+        setCurrentInstance(instance);
+        destroyGameInstance(finished);
+        clearRewind();
+        autopilot.hold = 0;
+    }
+    if (-- autopilot.hold <= 0) {
+        setInstanceInput(getCurrentInstance(), getAutopilotInput(&autopilot.random, &autopilot.hold));
+    }
+}
+
+// The input is sampled as late as possible, right before the tick, and the
+// result is presented right after it, so a key press is shown in the same frame
+static void processFrame()
+{
+    const Uint64 frameStart = beginTrace();
+
+    // Read all events, this also updates the keyboard state
+    Uint64 traceStart = beginTrace();
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        recordInputEvent(&event);
+        if (event.type == SDL_QUIT) {
+            game.state = STATE_QUIT;
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_F11) {
+            toggleFullscreen();
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == MEMORY_DUMP_KEY) {
+            printMemoryStats();
+        } else if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == MINIMAP_KEY) {
+            toggleMinimap();
+        }
+    }
+
+    if (autopilot.enabled) {
+        updateAutopilot();
+    }
+    endPhaseTrace("events", traceStart);
+
+    // Swap in the levels changed in the levels file
+    traceStart = beginTrace();
+    updateHotReload();
+    endPhaseTrace("hot reload", traceStart);
+
+    // Process user input and game logic, or step back while the rewind key is held
+    traceStart = beginTrace();
+    if (game.state != STATE_QUIT && game.keystate[REWIND_KEY]) {
+        rewindTicks(REWIND_SPEED);
+        rewinding = 1;
+    } else {
+        processTick();
+    }
+    endPhaseTrace("tick", traceStart);
+
+    traceStart = beginTrace();
+    if (!game.keystate[REWIND_KEY]) {
+        if (rewinding) {
+            rewinding = 0;
+            printRewindStats();
+        }
+        recordTick();
+    }
+    endPhaseTrace("record", traceStart);
+
+    // Draw screen
+    traceStart = beginTrace();
+    beginFrame();
+
+    drawScreen();
+    drawHud();
+    drawMinimap();
+
+    if (game.state == STATE_KILLED) {
+        drawMessage(MESSAGE_PLAYER_KILLED);
 
-    // Delete unused objects from memory
-    if (current_time >= game.cleanTime) {
-        game.cleanTime = current_time + CLEAN_PERIOD;
-        ObjectArray_clean(&level->objects);
+    } else if (game.state == STATE_LEVELCOMPLETE) {
+        drawMessage(MESSAGE_LEVEL_COMPLETE);
+
+    } else if (game.state == STATE_GAMEOVER) {
+        drawMessage(MESSAGE_GAME_OVER);
     }
+    endPhaseTrace("draw", traceStart);
+
+    traceStart = beginTrace();
+    presentFrame();
+    endPhaseTrace("present", traceStart);
+    recordPresent();
+    endMemoryFrame();
+    endPhaseTrace("frame", frameStart);
 
 #ifdef DEBUG_MODE
     printf("fps=%f, objects=%d\n", getCurrentFps(), level->objects.count);
@@ -439,22 +831,26 @@ static void processFrame()
 static void onExit()
 {
     stopFrameControl();
+    freeRewind();
+    freeHotReload();
+    printLatencyStats();
     
     TTF_Quit();
+    closePack();
     SDL_Quit();
 }
 
-void initGame()
+void initGame( int scale, int fullscreen )
 {
     atexit(onExit);
 
-    initRender("image/sprites.bmp", "font/PressStart2P.ttf");
-    initTypes();
-    initPlayer(&player);
-    initLevels();
+    openPack(PACK_PATH);
+    initRender("image/sprites.bmp", "font/PressStart2P.ttf", scale, fullscreen);
 
-    game.keystate = SDL_GetKeyboardState(NULL);
-    game.state = STATE_PLAYING;
+    GameInstance* instance = createGameInstance();
+    instance->keystate = SDL_GetKeyboardState(NULL);
+    setCurrentInstance(instance);
+    initRewind();
 }
 
 void runGame()
@@ -462,7 +858,7 @@ void runGame()
     startFrameControl(FRAME_RATE, MAX_DELTA_TIME);
 
     while (game.state != STATE_QUIT) {
-        processFrame();
         waitForNextFrame();
+        processFrame();
     }
 }
@@ -9,15 +9,35 @@
 
 #include "types.h"
 
-extern Level* level;
-extern Player player;
+extern __thread Level* level;
+extern __thread Player* player;
 
-void initGame();
+void initGame( int scale, int fullscreen );
 void runGame();
+void setAutopilot( int enabled ); // Random input instead of the keyboard, for benchmarks
+void processTick();     // Game logic of one frame, without rendering and events
+int isGameRunning();
 
 void setLevel( int r, int c );
 void completeLevel();
 
+// The state of the game loop (not levels or player), for snapshots
+int getGameStateSize();
+void saveGameState( void* state );
+void restoreGameState( const void* state );
+void resetGameState();
+void setKeyState( const Uint8* keystate );
+
+// Keys of the object random numbers, see getObjectRandom()
+void setWorldSeed( Uint32 seed );
+Uint32 getWorldSeed();
+Uint32 getTickCount();  // Processed ticks
+Uint32 newObjectId();
+
+void sleepObject( Object* object, int ms );
+void wakeObject( Object* object );
+void resetSleepers( Level* level );
+
 void damagePlayer( int damage );
 void killPlayer();
 
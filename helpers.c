@@ -7,21 +7,33 @@
 #include "helpers.h"
 #include "game.h"
 #include "levels.h"
+#include "framecontrol.h"
 
 
 int isCellValid( int r, int c )
 {
-    return r >= 0 && r < ROW_COUNT && c >= 0 && c < COLUMN_COUNT;
+    return r >= 0 && r < level->rows && c >= 0 && c < level->columns;
 }
 
 int isSolid( int r, int c, int flags )
 {
-    return isCellValid(r, c) ? (level->cells[r][c]->solid & flags) == flags : 0;
+    return isCellValid(r, c) ? (getCell(level, r, c)->solid & flags) == flags : 0;
+}
+
+// Returns 1 if any cell within [c1; c2] of the row is solid from left and right
+int hasWalls( int r, int c1, int c2 )
+{
+    if (r < 0 || r >= level->rows) {
+        return 0;
+    }
+    c1 = c1 < 0 ? 0 : c1;
+    c2 = c2 >= level->columns ? level->columns - 1 : c2;
+    return c1 <= c2 && countWalls(level, r, c2 + 1) > countWalls(level, r, c1);
 }
 
 int isLadder( int r, int c )
 {
-    return isCellValid(r, c) ? level->cells[r][c]->generalTypeId == TYPE_LADDER : 0;
+    return isCellValid(r, c) ? getCell(level, r, c)->generalTypeId == TYPE_LADDER : 0;
 }
 
 // Returns 1 if there is a ladder at (r, c) and player can stay on it
@@ -33,20 +45,24 @@ int isSolidLadder( int r, int c )
 
 int isWater( int r, int c )
 {
-    return isCellValid(r, c) ? level->cells[r][c]->generalTypeId == TYPE_WATER : 0;
+    return isCellValid(r, c) ? getCell(level, r, c)->generalTypeId == TYPE_WATER : 0;
 }
 
 int cellContains( int r, int c, ObjectTypeId generalType )
 {
-    return isCellValid(r, c) ? level->cells[r][c]->generalTypeId == generalType : 0;
+    return isCellValid(r, c) ? getCell(level, r, c)->generalTypeId == generalType : 0;
 }
 
 int hitTest( Object* object1, Object* object2 )
 {
+    // Compares the doubled distances between the body centers, to avoid division.
+    // The doubled positions may not fit Fixed, so they are 64-bit.
     const SDL_Rect o1 = object1->type->body;
     const SDL_Rect o2 = object2->type->body;
-    if (fabs((object1->x + o1.x + o1.w / 2.0) - (object2->x + o2.x + o2.w / 2.0)) < (o1.w + o2.w) / 2.0 &&
-        fabs((object1->y + o1.y + o1.h / 2.0) - (object2->y + o2.y + o2.h / 2.0)) < (o1.h + o2.h) / 2.0) {
+    const Sint64 dx = ((Sint64)object1->x * 2 + intToFixed(o1.x * 2 + o1.w)) - ((Sint64)object2->x * 2 + intToFixed(o2.x * 2 + o2.w));
+    const Sint64 dy = ((Sint64)object1->y * 2 + intToFixed(o1.y * 2 + o1.h)) - ((Sint64)object2->y * 2 + intToFixed(o2.y * 2 + o2.h));
+    if ((dx < 0 ? -dx : dx) < intToFixed(o1.w + o2.w) &&
+        (dy < 0 ? -dy : dy) < intToFixed(o1.h + o2.h)) {
         return 1;
     }
     return 0;
@@ -55,17 +71,17 @@ int hitTest( Object* object1, Object* object2 )
 void getObjectCell( Object* object, int* r, int* c )
 {
     const SDL_Rect body = object->type->body;
-    *r = (object->y + body.y + body.h / 2.0) / CELL_SIZE;
-    *c = (object->x + body.x + body.w / 2.0) / CELL_SIZE;
+    *r = fixedToInt(object->y + intToFixed(body.y) + intToFixed(body.h) / 2) / CELL_SIZE;
+    *c = fixedToInt(object->x + intToFixed(body.x) + intToFixed(body.w) / 2) / CELL_SIZE;
 }
 
 void getObjectBody( Object* object, Borders* borders )
 {
     const SDL_Rect body = object->type->body;
-    borders->left = object->x + body.x;
-    borders->right = borders->left + body.w;
-    borders->top = object->y + body.y;
-    borders->bottom = borders->top + body.h;
+    borders->left = object->x + intToFixed(body.x);
+    borders->right = borders->left + intToFixed(body.w);
+    borders->top = object->y + intToFixed(body.y);
+    borders->bottom = borders->top + intToFixed(body.h);
 }
 
 void getObjectPos( Object* object, int* r, int* c, Borders* cell, Borders* body )
@@ -73,10 +89,10 @@ void getObjectPos( Object* object, int* r, int* c, Borders* cell, Borders* body
     getObjectCell(object, r, c);
     getObjectBody(object, body);
 
-    cell->left = CELL_SIZE * (*c);
-    cell->right = cell->left + CELL_SIZE;
-    cell->top = CELL_SIZE * (*r);
-    cell->bottom = cell->top + CELL_SIZE;
+    cell->left = intToFixed(CELL_SIZE * (*c));
+    cell->right = cell->left + intToFixed(CELL_SIZE);
+    cell->top = intToFixed(CELL_SIZE * (*r));
+    cell->bottom = cell->top + intToFixed(CELL_SIZE);
 }
 
 int findNearDoor( int* r, int* c )
@@ -97,15 +113,22 @@ int findNearDoor( int* r, int* c )
     return 0;
 }
 
+// Returns the top-most item in the cell
 Object* findNearItem( int r, int c )
 {
-    for (int i = level->objects.count - 1; i >= 0; -- i) {
-        Object* object = level->objects.array[i];
-        if (object->type->generalTypeId == TYPE_ITEM && !object->removed) {
-            int or, oc;
-            getObjectCell(object, &or, &oc);
-            if (or == r && oc == c) {
-                return object;
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        if (objectTypes[t].generalTypeId != TYPE_ITEM) {
+            continue;
+        }
+        const ObjectArray* bucket = &level->objects.buckets[t];
+        for (int i = bucket->count - 1; i >= 0; -- i) {
+            Object* object = bucket->array[i];
+            if (!object->removed) {
+                int or, oc;
+                getObjectCell(object, &or, &oc);
+                if (or == r && oc == c) {
+                    return object;
+                }
             }
         }
     }
@@ -114,13 +137,35 @@ Object* findNearItem( int r, int c )
 
 Object* findObject( Level* level, ObjectTypeId typeId )
 {
-    for (int i = 0; i < level->objects.count; ++ i) {
-        Object* object = level->objects.array[i];
-        if (object->type->typeId == typeId) {
-            return object;
-        }
-    }
-    return NULL;
+    const ObjectArray* bucket = &level->objects.buckets[typeId];
+    return bucket->count ? bucket->array[0] : NULL;
+}
+
+// Returns the frame time in seconds. It's the only place where the frame time
+// is converted to fixed-point, so the same frame times give the same results.
+Fixed getElapsedFrameSeconds()
+{
+    return (Fixed)(getElapsedFrameTime() * (FIXED_ONE / 1000.0));
+}
+
+static inline Uint64 mix64( Uint64 x )
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// Counter-based random numbers: the result is a hash (SplitMix64 finalizer) of
+// the world seed, object id, tick and the count of numbers the object has taken
+// before. So each object has its own reproducible stream, which doesn't depend
+// on the order the objects are processed in and has no shared state.
+// Returns a number in [0; 2^31 - 1].
+int getObjectRandom( Object* object )
+{
+    const Uint64 key = mix64(((Uint64)getWorldSeed() << 32) | object->id);
+    const Uint64 counter = ((Uint64)getTickCount() << 32) | object->randomCount ++;
+    return (int)(mix64(key ^ mix64(counter)) >> 33);
 }
 
 double limitAbs(double value, double max)
@@ -11,6 +11,7 @@
 
 int isCellValid( int r, int c );
 int isSolid( int r, int c, int flags );
+int hasWalls( int r, int c1, int c2 );
 int isLadder( int r, int c );
 int isSolidLadder( int r, int c );
 int isWater( int r, int c );
@@ -25,6 +26,10 @@ int findNearDoor( int* r, int* c );
 Object* findNearItem( int r, int c );
 Object* findObject( Level* level, ObjectTypeId typeId );
 
+Fixed getElapsedFrameSeconds();
+
+int getObjectRandom( Object* object );
+
 double limitAbs(double value, double max);
 void ensure(int condition, const char* message);
 
@@ -0,0 +1,218 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "hotreload.h"
+#include "leveldata.h"
+#include "levels.h"
+#include "game.h"
+#include "rewind.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+enum
+{
+    RELOAD_BUDGET = 2000    // Microseconds per frame for rebuilding the levels
+};
+
+static struct
+{
+    char* path;
+    const char* name;       // File name in the path
+    int fd;                 // inotify, -1 if not watching
+    WorldData world;
+    int loaded;
+    int pending[LEVEL_COUNTY][LEVEL_COUNTX]; // Changed levels not rebuilt yet
+    int pendingCount;
+} reload = {.fd = -1};
+
+
+static char* readFile( const char* path )
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = (char*)malloc(size + 1);
+    text[fread(text, 1, size, file)] = 0;
+    fclose(file);
+    return text;
+}
+
+// Parses the file reusing the unchanged levels of the current world, returns 0
+// if it can't be loaded. The current world is kept then.
+static int loadWorld( const char* path, WorldData* world )
+{
+    char* text = readFile(path);
+    if (!text) {
+        return 0;
+    }
+    const int valid = parseWorld(text, reload.loaded ? &reload.world : NULL, world);
+    free(text);
+    if (!valid) {
+        freeWorld(world);
+    }
+    return valid;
+}
+
+// The directory is watched instead of the file, because editors often save
+// by writing a new file and renaming it over the old one
+static void watchFile( const char* path )
+{
+    reload.path = strdup(path);
+    const char* slash = strrchr(reload.path, '/');
+    reload.name = slash ? slash + 1 : reload.path;
+
+#ifdef __linux__
+    char* directory = slash ? strndup(reload.path, slash - reload.path + 1) : strdup(".");
+    reload.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (reload.fd != -1 && inotify_add_watch(reload.fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+        close(reload.fd);
+        reload.fd = -1;
+    }
+    free(directory);
+#endif
+    if (reload.fd == -1) {
+        printf("hot reload: can't watch %s, it's loaded only once\n", path);
+    }
+}
+
+int initHotReload( const char* path )
+{
+    if (!loadWorld(path, &reload.world)) {
+        return 0;
+    }
+    reload.loaded = 1;
+    reload.pendingCount = 0;
+    setWorldData(&reload.world);
+    watchFile(path);
+    return 1;
+}
+
+void freeHotReload()
+{
+#ifdef __linux__
+    if (reload.fd != -1) {
+        close(reload.fd);
+    }
+#endif
+    reload.fd = -1;
+    free(reload.path);
+    reload.path = NULL;
+    if (reload.loaded) {
+        setWorldData(NULL);
+        freeWorld(&reload.world);
+        reload.loaded = 0;
+    }
+}
+
+// Returns 1 if the file was written since the last call
+static int isFileChanged()
+{
+    int changed = 0;
+#ifdef __linux__
+    if (reload.fd == -1) {
+        return 0;
+    }
+    char buffer[sizeof(struct inotify_event) + NAME_MAX + 1] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t size;
+    while ((size = read(reload.fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + size; ) {
+            const struct inotify_event* event = (const struct inotify_event*)p;
+            if (event->len && strcmp(event->name, reload.name) == 0) {
+                changed = 1;
+            }
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+    return changed;
+}
+
+// Marks the levels whose text changed, the world data of the others is only
+// copied. The old world can be freed right away, because the levels don't
+// refer to it.
+static void loadChangedLevels()
+{
+    WorldData world;
+    if (!loadWorld(reload.path, &world)) {
+        printf("hot reload: %s can't be loaded or does not match the levels count or sizes\n", reload.path);
+        return;
+    }
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            const LevelData* previous = &reload.world.levels[lr][lc];
+            const LevelData* next = &world.levels[lr][lc];
+            if (!reload.pending[lr][lc] && (previous->hash != next->hash ||
+                previous->rows != next->rows || previous->columns != next->columns)) {
+                reload.pending[lr][lc] = 1;
+                reload.pendingCount += 1;
+            }
+        }
+    }
+    freeWorld(&reload.world);
+    reload.world = world;
+}
+
+static int isSizeChanged()
+{
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            const LevelData* data = &reload.world.levels[lr][lc];
+            if (reload.pending[lr][lc] && (data->rows != levels[lr][lc].rows || data->columns != levels[lr][lc].columns)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void rebuildLevel( int r, int c )
+{
+    reloadLevel(r, c);
+    reload.pending[r][c] = 0;
+    reload.pendingCount -= 1;
+}
+
+// The current level is rebuilt first, then the others while the frame budget
+// lasts, at least one per frame. If a size changed, all the pending levels are
+// rebuilt at once, because the neighbour levels must have the same sizes.
+void updateHotReload()
+{
+    if (isFileChanged()) {
+        loadChangedLevels();
+    }
+    if (reload.pendingCount == 0) {
+        return;
+    }
+
+    const int all = isSizeChanged();
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const Uint64 budget = RELOAD_BUDGET * SDL_GetPerformanceFrequency() / 1000000;
+    if (reload.pending[level->r][level->c]) {
+        rebuildLevel(level->r, level->c);
+    }
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            if (reload.pending[lr][lc] && (all || SDL_GetPerformanceCounter() - start < budget)) {
+                rebuildLevel(lr, lc);
+            }
+        }
+    }
+    clearRewind();
+    if (reload.pendingCount == 0) {
+        printf("hot reload: levels rebuilt\n");
+    }
+}
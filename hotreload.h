@@ -0,0 +1,22 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include "types.h"
+
+// The levels can be loaded from a file instead of the built-in ones (see
+// parseWorld() for the format). The file is watched while the game runs: when
+// it's saved, only the levels whose text changed are parsed and rebuilt, in
+// place and between the ticks, a few per frame. Watching needs inotify, so on
+// other systems the file is only loaded.
+
+int initHotReload( const char* path ); // Before the game is created, returns 0 if the file can't be loaded
+void updateHotReload();                // Between the ticks
+void freeHotReload();
+
+#endif
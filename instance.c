@@ -0,0 +1,199 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "instance.h"
+#include "game.h"
+#include "helpers.h"
+#include "framecontrol.h"
+#include "memory.h"
+#include <string.h>
+#include <stdio.h>
+
+static __thread GameInstance* currentInstance = NULL;
+
+
+static int getStateSize()
+{
+    return getGameStateSize() + getFrameControlStateSize();
+}
+
+static void bindInstance( GameInstance* instance )
+{
+    currentInstance = instance;
+    levels = instance ? instance->levels : NULL;
+    player = instance ? &instance->player : NULL;
+    level = instance ? instance->level : NULL;
+}
+
+// Saves the per thread state of the current instance
+static void saveInstanceState( GameInstance* instance )
+{
+    Uint8* state = instance->state;
+    instance->level = level;
+    saveGameState(state);
+    state += getGameStateSize();
+    saveFrameControlState(state);
+}
+
+static void loadInstanceState( GameInstance* instance )
+{
+    const Uint8* state = instance->state;
+    restoreGameState(state);
+    state += getGameStateSize();
+    restoreFrameControlState(state);
+    setKeyState(instance->keystate);
+}
+
+GameInstance* createGameInstance()
+{
+    GameInstance* instance = (GameInstance*)allocMemory(MEMORY_LEVELS, sizeof(GameInstance));
+    memset(instance, 0, sizeof(GameInstance));
+    instance->state = (Uint8*)allocMemory(MEMORY_LEVELS, getStateSize());
+    instance->keystate = instance->keys;
+
+    GameInstance* previous = currentInstance;
+    setCurrentInstance(NULL);
+    bindInstance(instance);
+    resetGameState();
+    resetFrameClock();
+    setKeyState(instance->keystate);
+    initPlayer(player);
+    initLevels();
+    setCurrentInstance(previous);
+    return instance;
+}
+
+void destroyGameInstance( GameInstance* instance )
+{
+    if (instance == currentInstance) {
+        setCurrentInstance(NULL);
+    }
+    for (int r = 0; r < LEVEL_COUNTY; ++ r) {
+        for (int c = 0; c < LEVEL_COUNTX; ++ c) {
+            ObjectLayers* objects = &instance->levels[r][c].objects;
+            for (int t = 0; t < TYPE_COUNT; ++ t) {
+                const ObjectArray* bucket = &objects->buckets[t];
+                for (int i = 0; i < bucket->count; ++ i) {
+                    if (bucket->array[i] != (Object*)&instance->player) {
+                        freeObject(bucket->array[i]);
+                    }
+                }
+            }
+            freeLevel(&instance->levels[r][c]);
+        }
+    }
+    for (int i = 0; i < instance->player.items.count; ++ i) {
+        freeObject(instance->player.items.array[i]);
+    }
+    ObjectArray_free(&instance->player.items);
+    freeMemory(MEMORY_LEVELS, instance->state, getStateSize());
+    freeMemory(MEMORY_LEVELS, instance, sizeof(GameInstance));
+}
+
+void setCurrentInstance( GameInstance* instance )
+{
+    if (instance == currentInstance) {
+        return;
+    }
+    if (currentInstance) {
+        saveInstanceState(currentInstance);
+    }
+    bindInstance(instance);
+    if (instance) {
+        loadInstanceState(instance);
+    }
+}
+
+GameInstance* getCurrentInstance()
+{
+    return currentInstance;
+}
+
+void setInstanceInput( GameInstance* instance, int input )
+{
+    instance->keys[SDL_SCANCODE_LEFT] = (input & INPUT_LEFT) != 0;
+    instance->keys[SDL_SCANCODE_RIGHT] = (input & INPUT_RIGHT) != 0;
+    instance->keys[SDL_SCANCODE_UP] = (input & INPUT_UP) != 0;
+    instance->keys[SDL_SCANCODE_DOWN] = (input & INPUT_DOWN) != 0;
+    instance->keys[SDL_SCANCODE_SPACE] = (input & INPUT_SPACE) != 0;
+}
+
+int stepGameInstance( GameInstance* instance, int input, int ticks )
+{
+    GameInstance* previous = currentInstance;
+    setCurrentInstance(instance);
+
+    setInstanceInput(instance, input);
+
+    int i = 0;
+    for (; i < ticks && isGameRunning(); ++ i) {
+        advanceFrameClock(1000.0 / FRAME_RATE);
+        processTick();
+    }
+
+    setCurrentInstance(previous);
+    return i;
+}
+
+// The autopilot holds a random input for a random time; the space is pressed
+// with any input, so the game goes on after the player is killed
+int getAutopilotInput( Uint32* random, int* hold )
+{
+    static const int INPUTS[] = {
+        INPUT_RIGHT, INPUT_LEFT, INPUT_RIGHT | INPUT_UP, INPUT_LEFT | INPUT_UP,
+        INPUT_UP, INPUT_DOWN, INPUT_RIGHT | INPUT_DOWN, 0
+    };
+    *random = *random * 1664525 + 1013904223;
+    *hold = FRAME_RATE / 4 + (*random >> 16) % FRAME_RATE;
+    return INPUTS[(*random >> 8) % (sizeof(INPUTS) / sizeof(INPUTS[0]))] | INPUT_SPACE;
+}
+
+int runSoakTest( int seconds )
+{
+    enum { SAMPLE_TICKS = FRAME_RATE * 10, MAX_SAMPLES = 4096 };
+    static long long samples[MAX_SAMPLES];
+
+    int sampleCount = seconds * FRAME_RATE / SAMPLE_TICKS;
+    sampleCount = sampleCount > MAX_SAMPLES ? MAX_SAMPLES : sampleCount;
+    ensure(sampleCount >= 8, "runSoakTest(): The test is too short");
+
+    GameInstance* instance = createGameInstance();
+    Uint32 random = 1;
+    int games = 1;
+    for (int s = 0; s < sampleCount; ++ s) {
+        for (int ticks = 0; ticks < SAMPLE_TICKS;) {
+            int hold;
+            const int input = getAutopilotInput(&random, &hold);
+            const int ran = stepGameInstance(instance, input, hold);
+            ticks += ran;
+            if (ran < hold) {
+                destroyGameInstance(instance);
+                instance = createGameInstance();
+                games += 1;
+            }
+        }
+        samples[s] = getUsedMemory();
+    }
+
+    // The first quarter is the warm-up. After it, the memory may only go up
+    // and down around the same level, so the second half of the samples must
+    // not reach higher than the first one.
+    const int start = sampleCount / 4;
+    const int middle = start + (sampleCount - start) / 2;
+    long long firstPeak = 0, secondPeak = 0;
+    for (int s = start; s < sampleCount; ++ s) {
+        long long* peak = s < middle ? &firstPeak : &secondPeak;
+        *peak = samples[s] > *peak ? samples[s] : *peak;
+    }
+    const long long tolerance = firstPeak / 20 + 1024;
+    const int failed = secondPeak > firstPeak + tolerance;
+
+    printf("soak test: %d s, %d games, memory peak %lld bytes, then %lld bytes: %s\n",
+           seconds, games, firstPeak, secondPeak, failed ? "FAILED, memory keeps growing" : "passed");
+    printMemoryStats();
+    destroyGameInstance(instance);
+    return failed;
+}
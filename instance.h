@@ -0,0 +1,57 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "types.h"
+#include "levels.h"
+
+// A game instance owns the whole game state, so many games can be run in one
+// process, e.g. for bots or soak tests. Each thread has its current instance,
+// which the game code works with (level, player, levels and the game loop
+// state are per thread). The instance can be stepped on any thread, but only
+// on one at a time.
+
+typedef enum
+{
+    INPUT_LEFT = 1,
+    INPUT_RIGHT = 2,
+    INPUT_UP = 4,
+    INPUT_DOWN = 8,
+    INPUT_SPACE = 16
+} GameInput;
+
+typedef struct
+{
+    Level levels[LEVEL_COUNTY][LEVEL_COUNTX];
+    Level* level;
+    Player player;
+    Uint8* state;               // Game loop and frame clock state while the instance is not current
+    const Uint8* keystate;      // Keyboard state, keys by default
+    Uint8 keys[SDL_NUM_SCANCODES];
+} GameInstance;
+
+GameInstance* createGameInstance();
+void destroyGameInstance( GameInstance* instance );
+void setCurrentInstance( GameInstance* instance );
+GameInstance* getCurrentInstance();
+
+// Runs the game logic of the given count of ticks (1 / FRAME_RATE seconds each)
+// with the input held, without rendering. Returns the count of ticks run, which
+// is less if the game is over.
+int stepGameInstance( GameInstance* instance, int input, int ticks );
+void setInstanceInput( GameInstance* instance, int input ); // Sets the keys of the instance
+
+// Random input for the bots, held for the returned count of ticks
+int getAutopilotInput( Uint32* random, int* hold );
+
+// Plays the given game time with random input, restarting the game when it's
+// over, and checks that the used memory stops growing after a warm-up (see
+// memory.h). Returns 0 if so.
+int runSoakTest( int seconds );
+
+#endif
@@ -0,0 +1,97 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "latency.h"
+#include <stdio.h>
+
+enum
+{
+    MAX_PENDING_EVENTS = 64,
+    HISTOGRAM_SIZE = 1000,  // Buckets
+    BUCKETS_PER_MS = 10
+};
+
+static struct
+{
+    Uint64 pending[MAX_PENDING_EVENTS]; // Performance counter values of the events not presented yet
+    int pendingCount;
+    int histogram[HISTOGRAM_SIZE];      // The last bucket also counts the longer latencies
+    int samples;
+    double max;
+} latency;
+
+
+// The event timestamp has only ms resolution and the SDL_GetTicks() clock, so
+// the event time is taken as the current counter minus the time the event was
+// waiting in the queue
+void recordInputEvent( const SDL_Event* event )
+{
+    if ((event->type != SDL_KEYDOWN && event->type != SDL_KEYUP) || event->key.repeat) {
+        return;
+    }
+    if (latency.pendingCount == MAX_PENDING_EVENTS) {
+        return;
+    }
+    const Uint32 waited = SDL_GetTicks() - event->key.timestamp;
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const Uint64 queued = waited * SDL_GetPerformanceFrequency() / 1000;
+    latency.pending[latency.pendingCount ++] = now > queued ? now - queued : 0;
+}
+
+void recordPresent()
+{
+    if (latency.pendingCount == 0) {
+        return;
+    }
+    const Uint64 now = SDL_GetPerformanceCounter();
+    const double frequency = SDL_GetPerformanceFrequency() / 1000.0;
+    for (int i = 0; i < latency.pendingCount; ++ i) {
+        const double ms = (now - latency.pending[i]) / frequency;
+        int bucket = (int)(ms * BUCKETS_PER_MS);
+        if (bucket >= HISTOGRAM_SIZE) {
+            bucket = HISTOGRAM_SIZE - 1;
+        }
+        latency.histogram[bucket] += 1;
+        latency.samples += 1;
+        if (ms > latency.max) {
+            latency.max = ms;
+        }
+    }
+    latency.pendingCount = 0;
+}
+
+// Returns the upper bound of the bucket which contains the given fraction of samples
+static double getPercentile( double fraction )
+{
+    const int target = (int)(latency.samples * fraction + 0.5);
+    int count = 0;
+    for (int i = 0; i < HISTOGRAM_SIZE; ++ i) {
+        count += latency.histogram[i];
+        if (count >= target && count > 0) {
+            return (i + 1) / (double)BUCKETS_PER_MS;
+        }
+    }
+    return latency.max;
+}
+
+void getLatencyStats( LatencyStats* stats )
+{
+    stats->samples = latency.samples;
+    stats->p50 = getPercentile(0.5);
+    stats->p90 = getPercentile(0.9);
+    stats->p99 = getPercentile(0.99);
+    stats->max = latency.max;
+}
+
+void printLatencyStats()
+{
+    LatencyStats stats;
+    getLatencyStats(&stats);
+    if (stats.samples > 0) {
+        printf("input latency: %d events, p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+               stats.samples, stats.p50, stats.p90, stats.p99, stats.max);
+    }
+}
@@ -0,0 +1,29 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include "SDL.h"
+
+// Input-to-present latency: the time from a key event to the end of the
+// present which first shows its result
+
+typedef struct
+{
+    int samples;
+    double p50;     // Milliseconds
+    double p90;     //
+    double p99;     //
+    double max;     //
+} LatencyStats;
+
+void recordInputEvent( const SDL_Event* event ); // Call for each polled event
+void recordPresent();                            // Call after the present
+void getLatencyStats( LatencyStats* stats );
+void printLatencyStats();
+
+#endif
@@ -0,0 +1,290 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "leveldata.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    const char** lines;     // Not terminated
+    int* lengths;
+    int count;
+    int widths[LEVEL_COUNTX];
+    int heights[LEVEL_COUNTY];
+} WorldText;
+
+
+// Returns ' ' outside the level, so the neighbours of the border cells can be
+// checked without special cases. The level begins at the row r0, column c0.
+static char getLevelChar( const WorldText* text, const LevelData* level, int r0, int c0, int r, int c )
+{
+    if (r < 0 || r >= level->rows || c < 0 || c >= level->columns) {
+        return ' ';
+    }
+    return c0 + c < text->lengths[r0 + r] ? text->lines[r0 + r][c0 + c] : ' ';
+}
+
+// Reads the sizes line if the string begins with the keyword, returns the
+// string after the line
+static const char* parseSizes( const char* string, const char* keyword, int* sizes, int count, int* valid )
+{
+    const int length = strlen(keyword);
+    if (strncmp(string, keyword, length) != 0 || string[length] != ' ') {
+        return string;
+    }
+    char* end = (char*)string + length;
+    for (int i = 0; i < count; ++ i) {
+        sizes[i] = strtol(end, &end, 10);
+        *valid = *valid && sizes[i] > 0 && sizes[i] <= LEVEL_MAX_SIZE;
+    }
+    while (*end == ' ' || *end == '\r') {
+        ++ end;
+    }
+    *valid = *valid && (*end == '\n' || *end == 0);
+    return *end ? end + 1 : end;
+}
+
+static int splitLines( const char* string, WorldText* text )
+{
+    int valid = 1;
+    for (int i = 0; i < LEVEL_COUNTX; ++ i) {
+        text->widths[i] = COLUMN_COUNT;
+    }
+    for (int i = 0; i < LEVEL_COUNTY; ++ i) {
+        text->heights[i] = ROW_COUNT;
+    }
+    string = parseSizes(string, "columns", text->widths, LEVEL_COUNTX, &valid);
+    string = parseSizes(string, "rows", text->heights, LEVEL_COUNTY, &valid);
+    text->lines = NULL;
+    text->lengths = NULL;
+    text->count = 0;
+    if (!valid) {
+        return 0;
+    }
+
+    int rowCount = 0, columnCount = 0;
+    for (int i = 0; i < LEVEL_COUNTY; ++ i) {
+        rowCount += text->heights[i];
+    }
+    for (int i = 0; i < LEVEL_COUNTX; ++ i) {
+        columnCount += text->widths[i];
+    }
+    text->lines = (const char**)malloc(sizeof(const char*) * rowCount);
+    text->lengths = (int*)malloc(sizeof(int) * rowCount);
+
+    while (*string) {
+        const char* end = strchr(string, '\n');
+        if (!end) {
+            end = string + strlen(string);
+        }
+        int length = end - string;
+        if (length > 0 && string[length - 1] == '\r') {
+            length -= 1;
+        }
+        if (length > 0) {
+            if (text->count == rowCount || length > columnCount) {
+                return 0;
+            }
+            text->lines[text->count] = string;
+            text->lengths[text->count ++] = length;
+        }
+        string = *end ? end + 1 : end;
+    }
+    return text->count == rowCount;
+}
+
+static void addObject( LevelData* level, LevelObject* objects, ObjectTypeId typeId, int r, int c, char data )
+{
+    LevelObject* object = &objects[level->objectCount ++];
+    object->typeId = typeId;
+    object->data = data;
+    object->r = r;
+    object->c = c;
+}
+
+// FNV-1a of the level size and chars
+static Uint32 hashLevel( const WorldText* text, const LevelData* level, int r0, int c0 )
+{
+    Uint32 hash = 2166136261u;
+    hash = (hash ^ level->rows) * 16777619u;
+    hash = (hash ^ level->columns) * 16777619u;
+    for (int r = 0; r < level->rows; ++ r) {
+        for (int c = 0; c < level->columns; ++ c) {
+            hash = (hash ^ (Uint8)getLevelChar(text, level, r0, c0, r, c)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void copyLevel( const WorldData* previous, int lr, int lc, WorldData* world )
+{
+    const LevelData* source = &previous->levels[lr][lc];
+    LevelData* level = &world->levels[lr][lc];
+    *level = *source;
+    level->cells = (const Uint8*)malloc(level->rows * level->columns);
+    level->objects = (const LevelObject*)malloc(sizeof(LevelObject) * SDL_max(level->objectCount, 1));
+    memcpy((void*)level->cells, source->cells, level->rows * level->columns);
+    memcpy((void*)level->objects, source->objects, sizeof(LevelObject) * level->objectCount);
+    if (previous->startLevelR == lr && previous->startLevelC == lc) {
+        world->startLevelR = lr;
+        world->startLevelC = lc;
+        world->startR = previous->startR;
+        world->startC = previous->startC;
+    }
+}
+
+static void parseLevel( const WorldText* text, int lr, int lc, int r0, int c0, const WorldData* previous, WorldData* world )
+{
+    LevelData* level = &world->levels[lr][lc];
+    level->rows = text->heights[lr];
+    level->columns = text->widths[lc];
+    level->hash = hashLevel(text, level, r0, c0);
+    if (previous && previous->levels[lr][lc].hash == level->hash &&
+        previous->levels[lr][lc].rows == level->rows && previous->levels[lr][lc].columns == level->columns) {
+        copyLevel(previous, lr, lc, world);
+        return;
+    }
+
+    Uint8* cells = (Uint8*)malloc(level->rows * level->columns);
+    LevelObject* objects = (LevelObject*)malloc(sizeof(LevelObject) * level->rows * level->columns);
+    memset(cells, TYPE_NONE, level->rows * level->columns);
+    level->objectCount = 0;
+
+    for (int r = 0; r < level->rows; ++ r) {
+        for (int c = 0; c < level->columns; ++ c) {
+            const char s = getLevelChar(text, level, r0, c0, r, c);
+            const char st = getLevelChar(text, level, r0, c0, r - 1, c);
+            const char sb = getLevelChar(text, level, r0, c0, r + 1, c);
+            Uint8* cell = &cells[r * level->columns + c];
+
+            // Wall and ground
+            if (s == '*' || s == 'x') {
+                const ObjectTypeId type = s == '*' ? TYPE_WALL : TYPE_GROUND;
+                const ObjectTypeId type_top = s == '*' ? TYPE_WALL_TOP : TYPE_GROUND_TOP;
+                *cell = r == 0 || st == '*' || st == 'x' ? type : type_top;
+            // Water
+            } else if (s == '~') {
+                if (r == 0 || st == '~' || st == 'x' || st == '*') {
+                    *cell = TYPE_WATER;
+                } else {
+                    addObject(level, objects, TYPE_WATER_TOP, r, c, 0);
+                }
+            // Pillar
+            } else if (s == '|') {
+                if (r == 0 || st == '*' || st == 'x') {
+                    *cell = TYPE_PILLAR_TOP;
+                } else if (r == level->rows - 1 || sb == '*' || sb == 'x') {
+                    *cell = TYPE_PILLAR_BOTTOM;
+                } else {
+                    *cell = TYPE_PILLAR;
+                }
+            // Spike
+            } else if (s == '^') {
+                *cell = st == '*' || st == 'x' ? TYPE_SPIKE_TOP : TYPE_SPIKE_BOTTOM;
+            // Other objects
+            } else if (s == '-') {
+                *cell = TYPE_WALL_STAIR;
+            } else if (s == ',') {
+                *cell = (c + 1) % 3 ? TYPE_GRASS : TYPE_GRASS_BIG;
+            } else if (s == '.') {
+                *cell = TYPE_MUSHROOM1 + c % 3;
+            } else if (s == ';') {
+                *cell = c % 2 ? TYPE_TREE1 : TYPE_TREE2;
+            } else if (s == '@') {
+                *cell = TYPE_ROCK;
+            } else if (s == '=') {
+                *cell = TYPE_LADDER;
+            } else if (s == 'd') {
+                *cell = TYPE_DOOR;
+            } else if (s == '<') {
+                *cell = TYPE_ARROW_LEFT;
+            } else if (s == '>') {
+                *cell = TYPE_ARROW_RIGHT;
+            } else if (s == 'o') {
+                addObject(level, objects, TYPE_COIN, r, c, 0);
+            } else if (s == 'O') {
+                addObject(level, objects, TYPE_GEM, r, c, 0);
+            } else if (s == 'k') {
+                addObject(level, objects, TYPE_KEY, r, c, 0);
+            } else if (s == 'h') {
+                addObject(level, objects, TYPE_HEART, r, c, 0);
+            } else if (s == 'a') {
+                addObject(level, objects, TYPE_APPLE, r, c, 0);
+            } else if (s == 'i') {
+                addObject(level, objects, TYPE_PEAR, r, c, 0);
+            } else if (s == 'S') {
+                addObject(level, objects, TYPE_STATUARY, r, c, 0);
+            } else if (s == 'g') {
+                addObject(level, objects, TYPE_GHOST, r, c, 0);
+            } else if (s == 's') {
+                addObject(level, objects, TYPE_SCORPION, r, c, 0);
+            } else if (s == 'p') {
+                addObject(level, objects, TYPE_SPIDER, r, c, 0);
+            } else if (s == 'r') {
+                addObject(level, objects, TYPE_RAT, r, c, 0);
+            } else if (s == 'b') {
+                addObject(level, objects, TYPE_BAT, r, c, 0);
+            } else if (s == 'q') {
+                addObject(level, objects, TYPE_BLOB, r, c, 0);
+            } else if (s == 'f') {
+                addObject(level, objects, TYPE_FIREBALL, r, c, 0);
+            } else if (s == 'e') {
+                addObject(level, objects, TYPE_SKELETON, r, c, 0);
+            } else if (s == '`') {
+                addObject(level, objects, TYPE_DROP, r, c, 0);
+            } else if (s == '_') {
+                addObject(level, objects, TYPE_PLATFORM, r, c, 0);
+            } else if (s == '/') {
+                addObject(level, objects, TYPE_SPRING, r, c, 0);
+            } else if (s == '&') {
+                addObject(level, objects, TYPE_CLOUD1, r, c, 0);
+            } else if (s == '!') {
+                addObject(level, objects, TYPE_TORCH, r, c, 0);
+            } else if (s >= '1' && s <= '9') {
+                addObject(level, objects, TYPE_ACTION, r, c, s);
+            // Start position
+            } else if (s == 'P') {
+                world->startLevelR = lr;
+                world->startLevelC = lc;
+                world->startR = r;
+                world->startC = c;
+            }
+        }
+    }
+
+    level->cells = cells;
+    level->objects = objects;
+}
+
+int parseWorld( const char* string, const WorldData* previous, WorldData* world )
+{
+    WorldText text;
+    const int valid = splitLines(string, &text);
+
+    memset(world, 0, sizeof(WorldData));
+    if (valid) {
+        for (int lr = 0, r0 = 0; lr < LEVEL_COUNTY; r0 += text.heights[lr ++]) {
+            for (int lc = 0, c0 = 0; lc < LEVEL_COUNTX; c0 += text.widths[lc ++]) {
+                parseLevel(&text, lr, lc, r0, c0, previous, world);
+            }
+        }
+    }
+    free(text.lines);
+    free(text.lengths);
+    return valid;
+}
+
+void freeWorld( WorldData* world )
+{
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            free((void*)world->levels[lr][lc].cells);
+            free((void*)world->levels[lr][lc].objects);
+        }
+    }
+    memset(world, 0, sizeof(WorldData));
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef LEVELDATA_H
+#define LEVELDATA_H
+
+#include "types.h"
+#include "levels.h"
+
+// The levels are parsed from the text (see levels.txt) at build time, so the
+// game only copies the ready cells and objects into its levels
+
+// Rows or columns. The positions in a level are Fixed, so twice the level
+// size in pixels must fit it: the objects may be outside the level a bit, and
+// the hit test doubles the positions.
+enum { LEVEL_MAX_SIZE = 1023 };
+_Static_assert(LEVEL_MAX_SIZE * CELL_SIZE * 2 <= FIXED_MAX_INT, "LEVEL_MAX_SIZE does not fit the Fixed positions");
+
+typedef struct
+{
+    Uint8 typeId;
+    char data;
+    Uint16 r;
+    Uint16 c;
+} LevelObject;
+
+typedef struct
+{
+    int rows;
+    int columns;
+    const Uint8* cells;             // Static object type ids, rows * columns, row by row
+    const LevelObject* objects;
+    int objectCount;
+    Uint32 hash;                    // Of the level text, to find the changed levels
+} LevelData;
+
+typedef struct WorldData
+{
+    LevelData levels[LEVEL_COUNTY][LEVEL_COUNTX];
+    int startLevelR;
+    int startLevelC;
+    int startR;
+    int startC;
+} WorldData;
+
+// Parses the levels text. It may begin with the sizes of the levels:
+//
+//   columns 20 40     Width of the levels in each column, LEVEL_COUNTX values
+//   rows 15 30        Height of the levels in each row, LEVEL_COUNTY values
+//
+// (ROW_COUNT and COLUMN_COUNT by default), then the levels follow as one text,
+// a line per cell row (empty lines are skipped, shorter lines are padded with
+// spaces). Returns 0 if the text does not match the levels count or sizes.
+// The levels whose text is the same as in the previous world (if it's not
+// NULL) are copied from it instead of parsing. The parsed world must be freed
+// with freeWorld().
+int parseWorld( const char* text, const WorldData* previous, WorldData* world );
+void freeWorld( WorldData* world );
+
+// Generated from levels.txt at build time, see tables.c
+extern const WorldData worldData;
+
+#endif
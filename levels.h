@@ -15,8 +15,14 @@ enum
     LEVEL_COUNTY = 2
 };
 
-extern Level levels[LEVEL_COUNTY][LEVEL_COUNTX];
+extern __thread Level (*levels)[LEVEL_COUNTX];
+
+struct WorldData;
 
 void initLevels();
+void setWorldData( const struct WorldData* world ); // For the next initLevels() and reloadLevel()
+void reloadLevel( int r, int c );   // Rebuilds the level of the current instance from the world data, keeping the player
+void getLevelOrigin( const Level* level, int* x, int* y ); // World pixels
+void getWorldSize( int* width, int* height );
 
 #endif
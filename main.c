@@ -5,10 +5,60 @@
  ******************************************************************************/
 
 #include "game.h"
+#include "snapshot.h"
+#include "instance.h"
+#include "render.h"
+#include "hotreload.h"
+#include "trace.h"
+#include "helpers.h"
+#include <string.h>
+#include <stdlib.h>
 
 int main( int argc, char* argv[] )
 {
-    initGame();
+    int scale = SIZE_FACTOR;
+    int fullscreen = 0;
+    int scrolling = 0;
+    int autopilot = 0;
+    int benchmark = 0;
+    int soakSeconds = 0;
+    const char* levelsFile = NULL;
+    for (int i = 1; i < argc; ++ i) {
+        if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            scale = atoi(argv[++ i]);
+        } else if (strcmp(argv[i], "--fullscreen") == 0) {
+            fullscreen = 1;
+        } else if (strcmp(argv[i], "--scrolling-camera") == 0) {
+            scrolling = 1;
+        } else if (strcmp(argv[i], "--autopilot") == 0) {
+            autopilot = 1;
+        } else if (strcmp(argv[i], "--benchmark-snapshot") == 0) {
+            benchmark = 1;
+        } else if (strcmp(argv[i], "--soak-test") == 0 && i + 1 < argc) {
+            soakSeconds = atoi(argv[++ i]);
+        } else if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc) {
+            levelsFile = argv[++ i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            startTrace(argv[++ i]);
+        }
+    }
+
+    if (levelsFile) {
+        ensure(initHotReload(levelsFile), "main(): Can't load the levels file");
+    }
+
+    // Runs without window
+    if (soakSeconds > 0) {
+        return runSoakTest(soakSeconds);
+    }
+
+    initGame(scale, fullscreen);
+    setScrollingCamera(scrolling);
+    setAutopilot(autopilot);
+    if (benchmark) {
+        benchmarkSnapshot(10000);
+        return 0;
+    }
     runGame();
     return 0;
 }
@@ -0,0 +1,173 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "memory.h"
+#include "helpers.h"
+#include "levels.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+#define ATOMIC_ADD(value, delta) __atomic_add_fetch(&(value), (delta), __ATOMIC_RELAXED)
+#define ATOMIC_LOAD(value) __atomic_load_n(&(value), __ATOMIC_RELAXED)
+
+static const char* const CATEGORY_NAMES[MEMORY_CATEGORY_COUNT] = {
+    "objects", "object arrays", "textures", "fonts", "levels", "history", "trace"
+};
+
+#define TYPE(typeId, ...) [typeId] = #typeId,
+#define TYPE_EX(typeId, ...) [typeId] = #typeId,
+static const char* const TYPE_NAMES[TYPE_COUNT] = {
+#include "types.def"
+};
+#undef TYPE
+#undef TYPE_EX
+
+static struct
+{
+    long long bytes[MEMORY_CATEGORY_COUNT];
+    long long peakBytes[MEMORY_CATEGORY_COUNT];
+    long long allocations[MEMORY_CATEGORY_COUNT];
+    long long totalAllocations;
+    long long frameStartAllocations;
+    int frameAllocations;
+    int maxFrameAllocations;
+    int liveObjects[TYPE_COUNT];
+    int peakObjects[TYPE_COUNT];
+} memory;
+
+
+// The peaks are updated without locking, so the concurrent updates may be
+// lost, but they can't be lower than any of the values
+static void updatePeak( long long* peak, long long value )
+{
+    long long current = ATOMIC_LOAD(*peak);
+    while (value > current && !__atomic_compare_exchange_n(peak, &current, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+static void countBytes( MemoryCategory category, long long bytes, int allocations )
+{
+    updatePeak(&memory.peakBytes[category], ATOMIC_ADD(memory.bytes[category], bytes));
+    if (allocations) {
+        ATOMIC_ADD(memory.allocations[category], allocations);
+        ATOMIC_ADD(memory.totalAllocations, allocations);
+    }
+}
+
+void* allocMemory( MemoryCategory category, size_t size )
+{
+    void* result = malloc(size);
+    ensure(result != NULL || size == 0, "allocMemory(): Can't allocate memory");
+    countBytes(category, size, 1);
+    return result;
+}
+
+void* reallocMemory( MemoryCategory category, void* memory, size_t oldSize, size_t newSize )
+{
+    void* result = realloc(memory, newSize);
+    ensure(result != NULL || newSize == 0, "reallocMemory(): Can't allocate memory");
+    countBytes(category, (long long)newSize - (long long)oldSize, 1);
+    return result;
+}
+
+void freeMemory( MemoryCategory category, void* memory, size_t size )
+{
+    if (memory) {
+        free(memory);
+        countBytes(category, -(long long)size, 0);
+    }
+}
+
+void trackMemory( MemoryCategory category, long long bytes )
+{
+    countBytes(category, bytes, bytes > 0);
+}
+
+void trackObjects( ObjectTypeId typeId, int count )
+{
+    const int live = ATOMIC_ADD(memory.liveObjects[typeId], count);
+    int peak = ATOMIC_LOAD(memory.peakObjects[typeId]);
+    while (live > peak && !__atomic_compare_exchange_n(&memory.peakObjects[typeId], &peak, live, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void endMemoryFrame()
+{
+    const long long total = ATOMIC_LOAD(memory.totalAllocations);
+    memory.frameAllocations = (int)(total - memory.frameStartAllocations);
+    memory.frameStartAllocations = total;
+    if (memory.frameAllocations > memory.maxFrameAllocations) {
+        memory.maxFrameAllocations = memory.frameAllocations;
+    }
+}
+
+long long getUsedMemory()
+{
+    long long total = 0;
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++ i) {
+        total += ATOMIC_LOAD(memory.bytes[i]);
+    }
+    return total;
+}
+
+void getMemoryStats( MemoryStats* stats )
+{
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++ i) {
+        stats->bytes[i] = ATOMIC_LOAD(memory.bytes[i]);
+        stats->peakBytes[i] = ATOMIC_LOAD(memory.peakBytes[i]);
+        stats->allocations[i] = ATOMIC_LOAD(memory.allocations[i]);
+    }
+    stats->totalBytes = getUsedMemory();
+    stats->frameAllocations = memory.frameAllocations;
+    stats->maxFrameAllocations = memory.maxFrameAllocations;
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        stats->liveObjects[t] = ATOMIC_LOAD(memory.liveObjects[t]);
+        stats->peakObjects[t] = ATOMIC_LOAD(memory.peakObjects[t]);
+    }
+}
+
+// The objects which are removed, but are still in the levels of the current
+// thread (they are dropped when their level is processed)
+static void countRemovedObjects( int removed[TYPE_COUNT] )
+{
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        removed[t] = 0;
+    }
+    if (!levels) {
+        return;
+    }
+    for (int r = 0; r < LEVEL_COUNTY; ++ r) {
+        for (int c = 0; c < LEVEL_COUNTX; ++ c) {
+            for (int t = 0; t < TYPE_COUNT; ++ t) {
+                const ObjectArray* bucket = &levels[r][c].objects.buckets[t];
+                for (int i = 0; i < bucket->count; ++ i) {
+                    removed[t] += bucket->array[i]->removed != 0;
+                }
+            }
+        }
+    }
+}
+
+void printMemoryStats()
+{
+    MemoryStats stats;
+    getMemoryStats(&stats);
+    int removed[TYPE_COUNT];
+    countRemovedObjects(removed);
+
+    printf("memory: %lld bytes, %d allocations in the last frame (max %d)\n",
+           stats.totalBytes, stats.frameAllocations, stats.maxFrameAllocations);
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++ i) {
+        printf("  %-14s %10lld bytes, peak %10lld, %lld allocations\n",
+               CATEGORY_NAMES[i], stats.bytes[i], stats.peakBytes[i], stats.allocations[i]);
+    }
+    printf("objects (type: live, removed, peak):\n");
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        if (stats.peakObjects[t] > 0) {
+            printf("  %-20s %6d %6d %6d\n", TYPE_NAMES[t], stats.liveObjects[t], removed[t], stats.peakObjects[t]);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include "types.h"
+#include <stddef.h>
+
+// Memory accounting. The game allocates through these functions, so the used
+// memory is known per subsystem; the memory owned by the libraries (textures,
+// fonts) is estimated and tracked separately. The counters are shared by all
+// threads.
+
+typedef enum
+{
+    MEMORY_OBJECTS = 0,
+    MEMORY_OBJECT_ARRAYS,
+    MEMORY_TEXTURES,        // Estimated as 4 bytes per pixel
+    MEMORY_FONTS,           // Font files
+    MEMORY_LEVELS,          // Levels and the game instances holding them
+    MEMORY_HISTORY,         // Snapshots and rewind
+    MEMORY_TRACE,           // Trace events
+    MEMORY_CATEGORY_COUNT
+} MemoryCategory;
+
+typedef struct
+{
+    long long bytes[MEMORY_CATEGORY_COUNT];
+    long long peakBytes[MEMORY_CATEGORY_COUNT];
+    long long allocations[MEMORY_CATEGORY_COUNT];  // Total count
+    long long totalBytes;
+    int frameAllocations;                          // In the last frame
+    int maxFrameAllocations;
+    int liveObjects[TYPE_COUNT];
+    int peakObjects[TYPE_COUNT];
+} MemoryStats;
+
+void* allocMemory( MemoryCategory category, size_t size );
+void* reallocMemory( MemoryCategory category, void* memory, size_t oldSize, size_t newSize );
+void freeMemory( MemoryCategory category, void* memory, size_t size );
+void trackMemory( MemoryCategory category, long long bytes ); // Allocated outside, < 0 if freed
+void trackObjects( ObjectTypeId typeId, int count );          // Allocated objects, < 0 if freed
+
+void endMemoryFrame();      // Call once per frame
+long long getUsedMemory();
+void getMemoryStats( MemoryStats* stats );
+void printMemoryStats();    // Also counts the removed objects of the current levels
+
+#endif
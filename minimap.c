@@ -0,0 +1,208 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "minimap.h"
+#include "render.h"
+#include "levels.h"
+#include "game.h"
+#include "helpers.h"
+#include "memory.h"
+
+enum
+{
+    MINIMAP_MAX_WIDTH = LEVEL_WIDTH / 4,    // Screen pixels
+    MINIMAP_MAX_HEIGHT = LEVEL_HEIGHT / 4,
+    MINIMAP_MAX_SCALE = 2,                  // Screen pixels per cell
+    MINIMAP_MARGIN = 4,
+    MINIMAP_MAX_KEYS = 64
+};
+
+static const SDL_Color PLAYER_COLOR = {255, 255, 255, 255};
+static const SDL_Color KEY_COLOR = {255, 220, 0, 255};
+static const SDL_Color FRAME_COLOR = {255, 255, 255, 255};
+
+static SDL_Texture* texture;
+static int textureWidth;    // Cells
+static int textureHeight;
+static SDL_Color cellColors[THEME_COUNT][TYPE_COUNT]; // Average colors of the cell sprites
+static int visible = 1;
+
+// What the texture shows now
+static struct
+{
+    const void* levels;
+    Uint32 revisions[LEVEL_COUNTY][LEVEL_COUNTX];
+    ThemeId themes[LEVEL_COUNTY][LEVEL_COUNTX];
+} cache;
+
+
+// Averages the sprite pixels over the black background, like they are drawn.
+// The sheet is ARGB8888, the transparent pixels have the color key or zero
+// alpha.
+static SDL_Color getAverageColor( const SDL_Surface* sheet, SDL_Rect rect, SDL_Color transparent )
+{
+    const Uint32 key = (Uint32)transparent.r << 16 | (Uint32)transparent.g << 8 | transparent.b;
+    Uint32 sum[3] = {0, 0, 0};
+    for (int y = rect.y; y < rect.y + rect.h; ++ y) {
+        const Uint32* pixel = (const Uint32*)((const Uint8*)sheet->pixels + y * sheet->pitch) + rect.x;
+        for (int x = 0; x < rect.w; ++ x, ++ pixel) {
+            if ((*pixel >> 24) && (*pixel & 0xFFFFFF) != key) {
+                sum[0] += (*pixel >> 16) & 0xFF;
+                sum[1] += (*pixel >> 8) & 0xFF;
+                sum[2] += *pixel & 0xFF;
+            }
+        }
+    }
+    const int count = rect.w * rect.h > 0 ? rect.w * rect.h : 1;
+    return (SDL_Color){sum[0] / count, sum[1] / count, sum[2] / count, 255};
+}
+
+// The sheet must be the loaded sprite sheet, it's only read here. The sheet
+// from the asset pack is ARGB8888 already and is read as is, the others are
+// converted.
+void initMinimap( SDL_Surface* spriteSheet, SDL_Color transparent )
+{
+    SDL_Surface* sheet = spriteSheet;
+    if (spriteSheet->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        sheet = SDL_ConvertSurfaceFormat(spriteSheet, SDL_PIXELFORMAT_ARGB8888, 0);
+        ensure(sheet != NULL, "initMinimap(): Can't convert sprite sheet");
+    }
+    SDL_LockSurface(sheet);
+    for (int theme = 0; theme < THEME_COUNT; ++ theme) {
+        for (int t = 0; t < TYPE_COUNT; ++ t) {
+            SDL_Rect rect = themeSprites[theme][t];
+            rect.w = SDL_max(SDL_min(rect.w, sheet->w - rect.x), 0);
+            rect.h = SDL_max(SDL_min(rect.h, sheet->h - rect.y), 0);
+            cellColors[theme][t] = getAverageColor(sheet, rect, transparent);
+        }
+    }
+    SDL_UnlockSurface(sheet);
+    if (sheet != spriteSheet) {
+        SDL_FreeSurface(sheet);
+    }
+    cache.levels = NULL;
+}
+
+void toggleMinimap()
+{
+    visible = !visible;
+}
+
+// The texture has a pixel per cell of the world, it's created again when the
+// world size changes (another game, or a level reloaded with another size).
+// Returns 1 if so.
+static int createTexture()
+{
+    int width, height;
+    getWorldSize(&width, &height);
+    width /= CELL_SIZE;
+    height /= CELL_SIZE;
+    if (texture && width == textureWidth && height == textureHeight) {
+        return 0;
+    }
+    if (texture) {
+        SDL_DestroyTexture(texture);
+        trackMemory(MEMORY_TEXTURES, -(long long)textureWidth * textureHeight * 4);
+    }
+    texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+    ensure(texture != NULL, "drawMinimap(): Can't create minimap texture");
+    trackMemory(MEMORY_TEXTURES, (long long)width * height * 4);
+    textureWidth = width;
+    textureHeight = height;
+    return 1;
+}
+
+static void updateLevel( const Level* level )
+{
+    SDL_Color* pixels = (SDL_Color*)SDL_malloc(sizeof(SDL_Color) * level->rows * level->columns);
+    SDL_Color* pixel = pixels;
+    for (int r = 0; r < level->rows; ++ r) {
+        for (int c = 0; c < level->columns; ++ c) {
+            *pixel ++ = cellColors[level->theme][getCell(level, r, c)->typeId];
+        }
+    }
+    int x, y;
+    getLevelOrigin(level, &x, &y);
+    const SDL_Rect rect = {x / CELL_SIZE, y / CELL_SIZE, level->columns, level->rows};
+    SDL_UpdateTexture(texture, &rect, pixels, sizeof(SDL_Color) * level->columns);
+    SDL_free(pixels);
+}
+
+// Re-renders only the levels whose cells or theme changed since the last frame
+static void updateTexture()
+{
+    const int all = createTexture() || cache.levels != (const void*)levels;
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            const Level* level = &levels[lr][lc];
+            if (all || cache.revisions[lr][lc] != level->revision || cache.themes[lr][lc] != level->theme) {
+                updateLevel(level);
+                cache.revisions[lr][lc] = level->revision;
+                cache.themes[lr][lc] = level->theme;
+            }
+        }
+    }
+    cache.levels = levels;
+}
+
+// Cell rect on the screen, by the level and its pixel position
+static SDL_Rect getMarker( const Level* level, Fixed x, Fixed y, SDL_Rect map, float scale )
+{
+    int originX, originY;
+    getLevelOrigin(level, &originX, &originY);
+    const int c = originX / CELL_SIZE + SDL_min(SDL_max(fixedToInt(x) + CELL_HALF, 0) / CELL_SIZE, level->columns - 1);
+    const int r = originY / CELL_SIZE + SDL_min(SDL_max(fixedToInt(y) + CELL_HALF, 0) / CELL_SIZE, level->rows - 1);
+    const int size = scale > 1 ? (int)scale : 1;
+    return (SDL_Rect){map.x + (int)(c * scale), map.y + (int)(r * scale), size, size};
+}
+
+// Draws the minimap in the bottom right corner, with the frame of the current
+// level and the markers of the player and the keys. Large worlds are scaled
+// down to fit.
+void drawMinimap()
+{
+    if (!visible) {
+        return;
+    }
+    updateTexture();
+
+    const float scale = SDL_min(MINIMAP_MAX_SCALE, SDL_min(MINIMAP_MAX_WIDTH / (float)textureWidth,
+                                                           MINIMAP_MAX_HEIGHT / (float)textureHeight));
+    SDL_Rect map = {0, 0, SDL_max((int)(textureWidth * scale), 1), SDL_max((int)(textureHeight * scale), 1)};
+    map.x = LEVEL_WIDTH - MINIMAP_MARGIN - map.w;
+    map.y = LEVEL_HEIGHT - MINIMAP_MARGIN - map.h;
+    SDL_RenderCopy(renderer, texture, NULL, &map);
+
+    int x, y;
+    getLevelOrigin(level, &x, &y);
+    const SDL_Rect frame = {map.x + (int)(x / CELL_SIZE * scale),
+                            map.y + (int)(y / CELL_SIZE * scale),
+                            SDL_max((int)(level->columns * scale), 1),
+                            SDL_max((int)(level->rows * scale), 1)};
+    SDL_SetRenderDrawColor(renderer, FRAME_COLOR.r, FRAME_COLOR.g, FRAME_COLOR.b, FRAME_COLOR.a);
+    SDL_RenderDrawRect(renderer, &frame);
+
+    // Keys of all levels, sleeping ones too
+    SDL_Rect keys[MINIMAP_MAX_KEYS];
+    int keyCount = 0;
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            const ObjectArray* bucket = &levels[lr][lc].objects.buckets[TYPE_KEY];
+            for (int i = 0; i < bucket->count && keyCount < MINIMAP_MAX_KEYS; ++ i) {
+                const Object* key = bucket->array[i];
+                if (!key->removed) {
+                    keys[keyCount ++] = getMarker(&levels[lr][lc], key->x, key->y, map, scale);
+                }
+            }
+        }
+    }
+    SDL_SetRenderDrawColor(renderer, KEY_COLOR.r, KEY_COLOR.g, KEY_COLOR.b, KEY_COLOR.a);
+    SDL_RenderFillRects(renderer, keys, keyCount);
+
+    const SDL_Rect marker = getMarker(level, player->x, player->y, map, scale);
+    SDL_SetRenderDrawColor(renderer, PLAYER_COLOR.r, PLAYER_COLOR.g, PLAYER_COLOR.b, PLAYER_COLOR.a);
+    SDL_RenderFillRect(renderer, &marker);
+}
@@ -0,0 +1,21 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include "types.h"
+
+// The minimap shows all the levels with one pixel per cell. Each level has its
+// own region in the minimap texture, which is updated only when the level
+// cells change (see Level::revision), so a frame costs one texture copy and a
+// few marker rects.
+
+void initMinimap( SDL_Surface* spriteSheet, SDL_Color transparent );
+void toggleMinimap();
+void drawMinimap();
+
+#endif
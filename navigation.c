@@ -0,0 +1,253 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "navigation.h"
+#include "game.h"
+#include "helpers.h"
+#include "memory.h"
+#include <string.h>
+
+// How far a jump reaches, in cells. About the jump of the player, which rises
+// a bit more than a cell and flies about two cells at the run speed.
+enum
+{
+    JUMP_ROWS = 1,
+    JUMP_COLUMNS = 2
+};
+
+static int isSolidAt( const Level* level, int r, int c, int flags )
+{
+    return r >= 0 && r < level->rows && c >= 0 && c < level->columns ?
+           (getCell(level, r, c)->solid & flags) == flags : 0;
+}
+
+static int isLadderAt( const Level* level, int r, int c )
+{
+    return r >= 0 && r < level->rows && c >= 0 && c < level->columns ?
+           getCell(level, r, c)->generalTypeId == TYPE_LADDER : 0;
+}
+
+static int canStand( const Level* level, int r, int c )
+{
+    return r >= 0 && c >= 0 && c < level->columns &&
+           !isSolidAt(level, r, c, SOLID_ALL) && isSolidAt(level, r + 1, c, SOLID_TOP);
+}
+
+// Returns 1 if the walking object can step into (r, c) moving in the direction
+// of dc (-1 or 1). Matches the checks of move() with HITTEST_ALL.
+static int canStep( const Level* level, int r, int c, int dc )
+{
+    if (c < 0 || c >= level->columns) {
+        return 0;
+    }
+    const int wall = dc > 0 ? SOLID_LEFT : SOLID_RIGHT;
+    return !isSolidAt(level, r, c, wall) &&
+           (isSolidAt(level, r + 1, c, SOLID_TOP) || isLadderAt(level, r + 1, c));
+}
+
+static void allocNavigation( Level* level )
+{
+    Navigation* nav = &level->navigation;
+    const int cellCount = level->rows * level->columns;
+    nav->spanLeft = (Sint16*)allocMemory(MEMORY_LEVELS, sizeof(Sint16) * cellCount);
+    nav->spanRight = (Sint16*)allocMemory(MEMORY_LEVELS, sizeof(Sint16) * cellCount);
+    nav->fallRow = (Sint16*)allocMemory(MEMORY_LEVELS, sizeof(Sint16) * cellCount);
+    nav->ladderTop = (Sint16*)allocMemory(MEMORY_LEVELS, sizeof(Sint16) * cellCount);
+    nav->ladderBottom = (Sint16*)allocMemory(MEMORY_LEVELS, sizeof(Sint16) * cellCount);
+    nav->jumpLeft = (int*)allocMemory(MEMORY_LEVELS, sizeof(int) * cellCount);
+    nav->jumpRight = (int*)allocMemory(MEMORY_LEVELS, sizeof(int) * cellCount);
+    nav->spots = (int*)allocMemory(MEMORY_LEVELS, sizeof(int) * cellCount);
+    nav->rowSpots = (int*)allocMemory(MEMORY_LEVELS, sizeof(int) * (level->rows + 1));
+}
+
+void freeNavigation( Level* level )
+{
+    Navigation* nav = &level->navigation;
+    if (nav->spots) {
+        const int cellCount = level->rows * level->columns;
+        freeMemory(MEMORY_LEVELS, nav->spanLeft, sizeof(Sint16) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->spanRight, sizeof(Sint16) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->fallRow, sizeof(Sint16) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->ladderTop, sizeof(Sint16) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->ladderBottom, sizeof(Sint16) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->jumpLeft, sizeof(int) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->jumpRight, sizeof(int) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->spots, sizeof(int) * cellCount);
+        freeMemory(MEMORY_LEVELS, nav->rowSpots, sizeof(int) * (level->rows + 1));
+    }
+    memset(nav, 0, sizeof(Navigation));
+}
+
+// Returns the cell where the object standing in (r, c) lands when it jumps in
+// the direction of dc (-1 or 1), or -1. The nearest column is taken, and the
+// highest row in it. The jump is stopped by a wall at the height of its top.
+static int findJumpTarget( const Level* level, int r, int c, int dc )
+{
+    const int wall = dc > 0 ? SOLID_LEFT : SOLID_RIGHT;
+    for (int d = 1; d <= JUMP_COLUMNS; ++ d) {
+        const int tc = c + dc * d;
+        if (tc < 0 || tc >= level->columns || isSolidAt(level, r - JUMP_ROWS, tc, wall)) {
+            break;
+        }
+        for (int tr = r - JUMP_ROWS; tr <= r; ++ tr) {
+            if (canStand(level, tr, tc)) {
+                return tr * level->columns + tc;
+            }
+        }
+    }
+    return -1;
+}
+
+static void buildNavigation( Level* level )
+{
+    Navigation* nav = &level->navigation;
+    const int rows = level->rows;
+    const int columns = level->columns;
+    if (!nav->spots) {
+        allocNavigation(level);
+    }
+
+    for (int r = 0; r < rows; ++ r) {
+        // Patrol spans
+        Sint16* spanLeft = &nav->spanLeft[r * columns];
+        Sint16* spanRight = &nav->spanRight[r * columns];
+        spanLeft[0] = 0;
+        for (int c = 1; c < columns; ++ c) {
+            spanLeft[c] = canStep(level, r, c - 1, -1) ? spanLeft[c - 1] : c;
+        }
+        spanRight[columns - 1] = columns - 1;
+        for (int c = columns - 2; c >= 0; -- c) {
+            spanRight[c] = canStep(level, r, c + 1, 1) ? spanRight[c + 1] : c;
+        }
+    }
+
+    for (int c = 0; c < columns; ++ c) {
+        // Fall rows, from the bottom
+        int land = -1;
+        for (int r = rows - 1; r >= 0; -- r) {
+            if (isSolidAt(level, r + 1, c, SOLID_TOP)) {
+                land = r;
+            }
+            nav->fallRow[r * columns + c] = isSolidAt(level, r, c, SOLID_ALL) ? -1 : land;
+        }
+
+        // Ladder links
+        int top = -1;
+        for (int r = 0; r < rows; ++ r) {
+            top = isLadderAt(level, r, c) ? (top < 0 ? r : top) : -1;
+            nav->ladderTop[r * columns + c] = top;
+        }
+        int bottom = -1;
+        for (int r = rows - 1; r >= 0; -- r) {
+            bottom = isLadderAt(level, r, c) ? (bottom < 0 ? r : bottom) : -1;
+            nav->ladderBottom[r * columns + c] = bottom;
+        }
+    }
+
+    // Jump edges, from the ends of the spans only, because the rest of the
+    // cells are reached by walking
+    for (int r = 0; r < rows; ++ r) {
+        for (int c = 0; c < columns; ++ c) {
+            const int i = r * columns + c;
+            const int stands = canStand(level, r, c);
+            nav->jumpLeft[i] = stands && nav->spanLeft[i] == c ? findJumpTarget(level, r, c, -1) : -1;
+            nav->jumpRight[i] = stands && nav->spanRight[i] == c ? findJumpTarget(level, r, c, 1) : -1;
+        }
+    }
+
+    // Spots. The bottom row is excluded, because there is no floor below it.
+    int count = 0;
+    for (int r = 0; r < rows; ++ r) {
+        nav->rowSpots[r] = count;
+        if (r == rows - 1) {
+            continue;
+        }
+        for (int c = 0; c < columns; ++ c) {
+            const int canMoveLeft  = !isSolidAt(level, r, c - 1, SOLID_RIGHT) && isSolidAt(level, r + 1, c - 1, SOLID_TOP);
+            const int canMoveRight = !isSolidAt(level, r, c + 1, SOLID_LEFT)  && isSolidAt(level, r + 1, c + 1, SOLID_TOP);
+            if (canStand(level, r, c) && (canMoveLeft || canMoveRight)) {
+                nav->spots[count ++] = r * columns + c;
+            }
+        }
+    }
+    nav->rowSpots[rows] = count;
+
+    nav->valid = 1;
+}
+
+const Navigation* getNavigation( Level* level )
+{
+    if (!level->navigation.valid) {
+        buildNavigation(level);
+    }
+    return &level->navigation;
+}
+
+// Returns the columns [left; right] which the object walking in the cell (r, c)
+// of the current level can reach
+void getPatrolSpan( int r, int c, int* left, int* right )
+{
+    const Navigation* nav = getNavigation(level);
+    *left = nav->spanLeft[r * level->columns + c];
+    *right = nav->spanRight[r * level->columns + c];
+}
+
+// Returns the row where the object falling from the cell (r, c) of the current
+// level lands, or -1 if it falls out of the level (or the cell is solid)
+int getFallRow( int r, int c )
+{
+    return getNavigation(level)->fallRow[r * level->columns + c];
+}
+
+// Returns 1 and the rows [top; bottom] of the ladder in the cell (r, c) of the
+// current level, or 0 if there is no ladder
+int getLadder( int r, int c, int* top, int* bottom )
+{
+    const Navigation* nav = getNavigation(level);
+    *top = nav->ladderTop[r * level->columns + c];
+    *bottom = nav->ladderBottom[r * level->columns + c];
+    return *top >= 0;
+}
+
+// Returns 1 and the cell where the object standing in (r, c) of the current
+// level lands when it jumps in the direction of dc (-1 or 1), or 0. Only the
+// ends of the patrol spans have jumps, see getPatrolSpan().
+int getJumpTarget( int r, int c, int dc, int* targetR, int* targetC )
+{
+    const Navigation* nav = getNavigation(level);
+    const int i = r * level->columns + c;
+    const int target = dc < 0 ? nav->jumpLeft[i] : nav->jumpRight[i];
+    if (target < 0) {
+        return 0;
+    }
+    *targetR = target / level->columns;
+    *targetC = target % level->columns;
+    return 1;
+}
+
+// Picks a spot on the current level by the random number (>= 0), except the
+// spots in excludedRow. Returns 0 if there are no such spots.
+int findSpot( int excludedRow, int random, int* r, int* c )
+{
+    const Navigation* nav = getNavigation(level);
+    int count = nav->rowSpots[level->rows];
+    int excludedStart = 0, excludedCount = 0;
+    if (excludedRow >= 0 && excludedRow < level->rows) {
+        excludedStart = nav->rowSpots[excludedRow];
+        excludedCount = nav->rowSpots[excludedRow + 1] - excludedStart;
+    }
+    count -= excludedCount;
+    if (count <= 0) {
+        return 0;
+    }
+    int i = random % count;
+    if (i >= excludedStart) {
+        i += excludedCount;
+    }
+    *r = nav->spots[i] / level->columns;
+    *c = nav->spots[i] % level->columns;
+    return 1;
+}
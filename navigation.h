@@ -0,0 +1,37 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef NAVIGATION_H
+#define NAVIGATION_H
+
+#include "types.h"
+
+/*
+ * The navigation data describes where the walking objects can go on a level:
+ *
+ * - Patrol spans: the columns reachable by walking left or right along the row,
+ *   without passing through the walls or stepping off the floor (ladder tops
+ *   count as the floor).
+ * - Spots: the cells where an object can stand and make at least one step.
+ * - Fall rows: the rows where the falling objects land.
+ * - Ladder links: the top and bottom rows of each ladder.
+ * - Jump edges: the cells where the jumps from the ends of the patrol spans
+ *   land, across the gaps or onto the higher floor.
+ *
+ * It's built on the first query after the level cells have changed, so the
+ * per-frame queries are the table lookups.
+ */
+
+const Navigation* getNavigation( Level* level );
+void freeNavigation( Level* level );
+
+void getPatrolSpan( int r, int c, int* left, int* right );
+int findSpot( int excludedRow, int random, int* r, int* c );
+int getFallRow( int r, int c );
+int getLadder( int r, int c, int* top, int* bottom );
+int getJumpTarget( int r, int c, int dc, int* targetR, int* targetC );
+
+#endif
@@ -10,6 +10,8 @@
 #include "levels.h"
 #include "game.h"
 #include "framecontrol.h"
+#include "navigation.h"
+#include "particles.h"
 #include <math.h>
 
 
@@ -36,97 +38,183 @@ typedef enum
     HITTEST_ALL = HITTEST_WALLS | HITTEST_FLOOR | HITTEST_LEVEL
 } HitTest;
 
+// Returns 1 if the object moving horizontally in the row r can't enter the
+// column c, according to hitTest flags. The wall is SOLID_LEFT when moving
+// right, and SOLID_RIGHT when moving left.
+static int isBlockedX( int r, int c, int wall, int hitTest )
+{
+    return ((hitTest & HITTEST_WALLS) && isSolid(r, c, wall)) ||
+           ((hitTest & HITTEST_LEVEL) && (c < 0 || c >= level->columns)) ||
+           ((hitTest & HITTEST_FLOOR) && !isSolid(r + 1, c, SOLID_TOP) && !isLadder(r + 1, c));
+}
+
+// The same as isBlockedX() for the vertical movement in the column c
+static int isBlockedY( int r, int c, int wall, int hitTest )
+{
+    return ((hitTest & HITTEST_WALLS) && isSolid(r, c, wall)) ||
+           ((hitTest & HITTEST_LEVEL) && (r < 0 || r >= level->rows));
+}
+
 // Moves the object and checks the walls, floor and level borders according
 // to hitTest flags. Returns 0 on success, otherwise returns the directions
 // which the object could not fully move to.
+//
+// The movement is swept: every cell border crossed by the object body is
+// checked, so the object can't pass through the walls at any speed. The
+// border is checked when the body crosses it, while the body center is still
+// in the previous cell.
 static int move( Object* object, int hitTest )
 {
-    const double dt = getElapsedFrameTime() / 1000.0;
-    const double dx = limitAbs(object->vx, MAX_SPEED) * dt;
-    const double dy = limitAbs(object->vy, MAX_SPEED) * dt;
-
-    const int check_walls = hitTest & HITTEST_WALLS;
-    const int check_floor = hitTest & HITTEST_FLOOR;
-    const int check_level = hitTest & HITTEST_LEVEL;
+    const Fixed dt = getElapsedFrameSeconds();
+    const Fixed dx = fixedMul(object->vx, dt);
+    const Fixed dy = fixedMul(object->vy, dt);
 
     const SDL_Rect bodyRect = object->type->body;
 
     int result = 0;
-    int r, c; Borders cell, body;
-    getObjectPos(object, &r, &c, &cell, &body);
+    int r, c; Borders body;
+    getObjectCell(object, &r, &c);
 
+    // X
     object->x += dx;
-    object->y += dy;
     getObjectBody(object, &body);
 
-    if (dx > 0 && body.right > cell.right) {
-        if ((check_walls && isSolid(r, c + 1, SOLID_LEFT)) ||
-            (check_level && body.right > LEVEL_WIDTH) || 
-            (check_floor && !isSolid(r + 1, c + 1, SOLID_TOP) && !isLadder(r + 1, c + 1))) {
-            object->x = cell.right - (bodyRect.x + bodyRect.w);
-            result |= DIRECTION_X;
+    if (dx > 0) {
+        for (int k = c; body.right > intToFixed(CELL_SIZE * (k + 1)); ++ k) {
+            if (isBlockedX(r, k + 1, SOLID_LEFT, hitTest)) {
+                object->x = intToFixed(CELL_SIZE * (k + 1) - (bodyRect.x + bodyRect.w));
+                result |= DIRECTION_X;
+                break;
+            }
+            if (k + 1 >= level->columns) {
+                break;
+            }
         }
-    } else if (dx < 0 && body.left < cell.left) {
-        if ((check_walls && isSolid(r, c - 1, SOLID_RIGHT)) ||
-            (check_level && body.left < 0) ||
-            (check_floor && !isSolid(r + 1, c - 1, SOLID_TOP) && !isLadder(r + 1, c - 1))) {
-            object->x = cell.left - bodyRect.x;
-            result |= DIRECTION_X;
+    } else if (dx < 0) {
+        for (int k = c; body.left < intToFixed(CELL_SIZE * k); -- k) {
+            if (isBlockedX(r, k - 1, SOLID_RIGHT, hitTest)) {
+                object->x = intToFixed(CELL_SIZE * k - bodyRect.x);
+                result |= DIRECTION_X;
+                break;
+            }
+            if (k - 1 < 0) {
+                break;
+            }
         }
     }
-    if (dy > 0 && body.bottom > cell.bottom) {
-        if ((check_walls && isSolid(r + 1, c, SOLID_TOP)) ||
-            (check_level && body.bottom > LEVEL_HEIGHT)) {
-            object->y = cell.bottom - (bodyRect.y + bodyRect.h);
-            result |= DIRECTION_Y;
+
+    // Y, in the column reached by the X movement
+    int unused;
+    getObjectCell(object, &unused, &c);
+    object->y += dy;
+    getObjectBody(object, &body);
+
+    if (dy > 0) {
+        for (int k = r; body.bottom > intToFixed(CELL_SIZE * (k + 1)); ++ k) {
+            if (isBlockedY(k + 1, c, SOLID_TOP, hitTest)) {
+                object->y = intToFixed(CELL_SIZE * (k + 1) - (bodyRect.y + bodyRect.h));
+                result |= DIRECTION_Y;
+                break;
+            }
+            if (k + 1 >= level->rows) {
+                break;
+            }
         }
-    } else if (dy < 0 && body.top < cell.top) {
-        if ((check_walls && isSolid(r - 1, c, SOLID_BOTTOM)) ||
-            (check_level && body.top < 0)) {
-            object->y = cell.top - bodyRect.y;
-            result |= DIRECTION_Y;
+    } else if (dy < 0) {
+        for (int k = r; body.top < intToFixed(CELL_SIZE * k); -- k) {
+            if (isBlockedY(k - 1, c, SOLID_BOTTOM, hitTest)) {
+                object->y = intToFixed(CELL_SIZE * k - bodyRect.y);
+                result |= DIRECTION_Y;
+                break;
+            }
+            if (k - 1 < 0) {
+                break;
+            }
         }
     }
 
     return result;
 }
 
-static void setSpeed( Object* object, double vx, double vy )
+// Moves the walking object within its patrol span. This is the same as
+// move(object, HITTEST_ALL) for the objects which don't move vertically, but
+// takes the walls and floor from the navigation data.
+static int patrol( Object* object )
+{
+    int r, c;
+    getObjectCell(object, &r, &c);
+    if (!isCellValid(r, c) || object->vy) {
+        return move(object, HITTEST_ALL);
+    }
+
+    int left, right;
+    getPatrolSpan(r, c, &left, &right);
+
+    const SDL_Rect bodyRect = object->type->body;
+    const Fixed minX = intToFixed(CELL_SIZE * left - bodyRect.x);
+    const Fixed maxX = intToFixed(CELL_SIZE * (right + 1) - (bodyRect.x + bodyRect.w));
+
+    object->x += fixedMul(object->vx, getElapsedFrameSeconds());
+    if (object->vx < 0 && object->x < minX) {
+        object->x = minX;
+        return DIRECTION_X;
+    }
+    if (object->vx > 0 && object->x > maxX) {
+        object->x = maxX;
+        return DIRECTION_X;
+    }
+    return 0;
+}
+
+static void setSpeed( Object* object, Fixed vx, Fixed vy )
 {
     object->vx = vx;
     object->vy = vy;
     object->anim.flip = vx < 0 ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
 }
 
+// Emits the effect at the body center
+static void emitEffect( Object* object, EffectId effect )
+{
+    const SDL_Rect* body = &object->type->body;
+    emitParticles(effect, fixedToInt(object->x) + body->x + body->w / 2, fixedToInt(object->y) + body->y + body->h / 2);
+}
+
 // Returns animation speed (frames per second) for the movement speed (pixels per second)
-static inline int speedToFps( double speed )
+static inline int speedToFps( Fixed speed )
 {
-    return ceil(fabs(speed / 12.0));
+    const Fixed step = intToFixed(12);
+    return (fixedAbs(speed) + step - 1) / step;
 }
 
 // Returns 1 if the source sees the target
 static int isVisible( Object* source, Object* target )
 {
-    if (target->y + CELL_SIZE > source->y + CELL_HALF &&
-        target->y < source->y + CELL_HALF) {
+    const int sx = fixedToInt(source->x);
+    const int sy = fixedToInt(source->y);
+    const int tx = fixedToInt(target->x);
+    const int ty = fixedToInt(target->y);
+    if (ty + CELL_SIZE > sy + CELL_HALF &&
+        ty < sy + CELL_HALF) {
         int x1, x2;
-        if (target->x < source->x && (source->anim.flip & SDL_FLIP_HORIZONTAL)) {
-            x1 = target->x;
-            x2 = source->x;
-        } else if (target->x > source->x && !(source->anim.flip & SDL_FLIP_HORIZONTAL)) {
-            x1 = source->x;
-            x2 = target->x;
+        if (tx < sx && (source->anim.flip & SDL_FLIP_HORIZONTAL)) {
+            x1 = tx;
+            x2 = sx;
+        } else if (tx > sx && !(source->anim.flip & SDL_FLIP_HORIZONTAL)) {
+            x1 = sx;
+            x2 = tx;
         } else {
             return 0;
         }
-        const int r = (source->y + CELL_HALF) / CELL_SIZE;
-        for (x1 = x1 + CELL_HALF; x1 < x2; x1 += CELL_SIZE) {
-            const int c = x1 / CELL_SIZE;
-            if (isSolid(r, c, SOLID_LEFT | SOLID_RIGHT)) {
-                return 0;
-            }
+        // Check the cells at x1 + CELL_HALF + CELL_SIZE * i, which are < x2
+        const int r = (sy + CELL_HALF) / CELL_SIZE;
+        x1 += CELL_HALF;
+        if (x1 >= x2) {
+            return 1;
         }
-        return 1;
+        const int c1 = x1 / CELL_SIZE;
+        const int c2 = c1 + (x2 - x1 - 1) / CELL_SIZE;
+        return !hasWalls(r, c1, c2);
     }
     return 0;
 }
@@ -149,11 +237,22 @@ static int isVisible( Object* source, Object* target )
  * will be in that state.
  *
  * Note: The minimum state value is usually 0, but it can be negative as well.
+ *
+ * While the object only waits for its state to change, it can sleep until then
+ * (see sleepUntilState()), and the slept time is added to its state on waking.
  */
 
+// Sleeps until the state reaches the given value, see sleepObject()
+static void sleepUntilState( Object* object, int state )
+{
+    if (object->state < state) {
+        sleepObject(object, state - object->state);
+    }
+}
+
 
 void Object_onInit( Object* object ) {}
-void Object_onFrame( Object* object ) {}
+void Object_onFrame( Object* object ) { sleepObject(object, 0); } // Nothing to do until the player is near
 void Object_onHit( Object* object ) {}
 
 
@@ -162,15 +261,15 @@ static const int ENEMY_WAITING = 12000;
 
 void MovingEnemy_onInit( Object* e )
 {
-    const int dir = rand() % 2 ? 1 : -1;
+    const int dir = getObjectRandom(e) % 2 ? 1 : -1;
     setSpeed(e, e->type->speed * dir, 0);
-    e->state = -rand() % ENEMY_MOVING;
+    e->state = -getObjectRandom(e) % ENEMY_MOVING;
 }
 
 void MovingEnemy_onFrame( Object* e )
 {
     if (e->state <= ENEMY_MOVING) {
-        if (move(e, HITTEST_ALL)) {
+        if (patrol(e)) {
             setSpeed(e, -e->vx, e->vy);
         }
         setAnimation(e, 1, 2, speedToFps(e->vx));
@@ -179,22 +278,25 @@ void MovingEnemy_onFrame( Object* e )
         setAnimation(e, 2, 2, 0);
 
     } else {
-        e->state = ENEMY_MOVING - rand() % (ENEMY_MOVING * 2);
-        if (rand() % 2) {
+        e->state = ENEMY_MOVING - getObjectRandom(e) % (ENEMY_MOVING * 2);
+        if (getObjectRandom(e) % 2) {
             setSpeed(e, -e->vx, e->vy);
         }
     }
 
     e->state += getElapsedFrameTime();
+    if (e->state > ENEMY_MOVING && e->state <= ENEMY_WAITING) {
+        sleepUntilState(e, ENEMY_WAITING + 1);
+    }
 }
 
 void MovingEnemy_onHit( Object* e )
 {
-    if (player.inAir && player.y < e->y) {
-        player.vy *= -2;
+    if (player->inAir && player->y < e->y) {
+        player->vy *= -2;
         return;
     }
-    if ((e->vx < 0 && player.x > e->x) || (e->vx > 0 && player.x < e->x)) {
+    if ((e->vx < 0 && player->x > e->x) || (e->vx > 0 && player->x < e->x)) {
         setSpeed(e, -e->vx, e->vy);
     }
     e->state = ENEMY_MOVING + 1;
@@ -210,13 +312,13 @@ static const int SHOOTINGENEMY_ATTACK2 = 1000;
 void ShootingEnemy_onFrame( Object* e )
 {
     if (e->state <= SHOOTINGENEMY_MOVING) {
-        if (isVisible(e, (Object*)&player)) {
+        if (isVisible(e, (Object*)player)) {
             Object* shot = createObject(level, TYPE_ICESHOT, 0, 0);
-            shot->x = e->anim.flip & SDL_FLIP_HORIZONTAL ? e->x - shot->type->sprite.w : e->x + e->type->sprite.w;
+            shot->x = e->anim.flip & SDL_FLIP_HORIZONTAL ? e->x - intToFixed(shot->type->sprite.w) : e->x + intToFixed(e->type->sprite.w);
             shot->y = e->y;
             setSpeed(shot, shot->vx * (e->vx > 0 ? 1 : -1), shot->vy);
             e->state = SHOOTINGENEMY_MOVING + 1;
-        } else if (move(e, HITTEST_ALL)) {
+        } else if (patrol(e)) {
             setSpeed(e, -e->vx, e->vy);
         }
         setAnimation(e, 1, 2, speedToFps(e->vx));
@@ -231,8 +333,10 @@ void ShootingEnemy_onFrame( Object* e )
         e->state = SHOOTINGENEMY_MOVING;
     }
 
-    if (e->state > SHOOTINGENEMY_MOVING)
+    if (e->state > SHOOTINGENEMY_MOVING) {
         e->state += getElapsedFrameTime();
+        sleepUntilState(e, e->state <= SHOOTINGENEMY_ATTACK1 ? SHOOTINGENEMY_ATTACK1 + 1 : SHOOTINGENEMY_ATTACK2 + 1);
+    }
 }
 
 
@@ -250,11 +354,13 @@ void Shot_onFrame( Object* e )
     if (e->state <= SHOT_MOVING) {
         if (move(e, HITTEST_WALLS | HITTEST_LEVEL)) {
             setAnimation(e, 3, 3, 0);
+            emitEffect(e, e->type->typeId == TYPE_FIRESHOT ? EFFECT_FIRE_DEBRIS : EFFECT_ICE_DEBRIS);
             e->state = SHOT_MOVING + 1;
         }
 
     } else if (e->state <= SHOT_HIT) {
         e->state += getElapsedFrameTime();
+        sleepUntilState(e, SHOT_HIT + 1);
 
     } else {
         e->removed = 1;
@@ -263,24 +369,28 @@ void Shot_onFrame( Object* e )
 
 void Shot_onHit( Object* e )
 {
+    if (e->state <= SHOT_MOVING) {
+        emitEffect(e, e->type->typeId == TYPE_FIRESHOT ? EFFECT_FIRE_DEBRIS : EFFECT_ICE_DEBRIS);
+    }
     setAnimation(e, 3, 3, 0);
     e->state = SHOT_MOVING + 1;
     killPlayer();
 }
 
 
-static const int BAT_FLY_HEIGHT = CELL_SIZE * 1.25;
+static const Fixed BAT_FLY_HEIGHT = FIXED(CELL_SIZE * 1.25);
 
 void Bat_onInit( Object* e )
 {
     MovingEnemy_onInit(e);
     setAnimation(e, 0, 1, speedToFps(e->vx));
-    setSpeed(e, e->vx, e->type->speed / 2.0);
+    setSpeed(e, e->vx, e->type->speed / 2);
     e->state = 0;
 }
 
 void Bat_onFrame( Object* e )
 {
+    // The state keeps the bottom of the flight area
     int r, c; Borders cell, body;
     if (e->state == 0) {
         getObjectPos(e, &r, &c, &cell, &body);
@@ -309,7 +419,7 @@ void Bat_onHit( Object* e )
 
 static const int ITEM_IDLE = 0;
 static const int ITEM_TAKEN = 1;
-static const double ITEM_FADE_SPEED = 0.25; // Seconds
+static const Fixed ITEM_FADE_SPEED = FIXED(0.25); // Seconds
 
 void Item_onHit( Object* item )
 {
@@ -317,19 +427,20 @@ void Item_onHit( Object* item )
         ObjectTypeId generalTypeId = item->type->generalTypeId;
 
         if (generalTypeId == TYPE_COIN) {
-            player.coins += 1;
+            player->coins += 1;
+            emitEffect(item, EFFECT_SPARKLES);
         } else if (generalTypeId == TYPE_KEY) {
-            player.keys += 1;
+            player->keys += 1;
         } else if (generalTypeId == TYPE_HEART) {
-            player.lives += 1;
+            player->lives += 1;
         } else if (generalTypeId == TYPE_STATUARY) {
             completeLevel();
         } else {
-            // Add the item to player.items, for example
+            // Add the item to player->items, for example
         }
 
         item->state = ITEM_IDLE + 1;
-        setSpeed(item, item->vx, -7 * 24);
+        setSpeed(item, item->vx, intToFixed(-7 * 24));
         setAnimation(item, 0, 0, 0);
     }
 }
@@ -337,16 +448,16 @@ void Item_onHit( Object* item )
 void Item_onFrame( Object* item )
 {
     if (item->state <= ITEM_IDLE) {
-        // Nothing
+        sleepObject(item, 0);
 
     } else if (item->state <= ITEM_TAKEN) {
-        const double dt = getElapsedFrameTime() / 1000.0;
-        item->anim.alpha -= (255 / ITEM_FADE_SPEED) * dt;
+        const Fixed fade = fixedDiv(getElapsedFrameSeconds(), ITEM_FADE_SPEED);
+        item->anim.alpha -= fixedToInt(fade * 255);
         if (item->anim.alpha < 0) {
             item->anim.alpha = 0;
             item->state = ITEM_TAKEN + 1;
         }
-        setSpeed(item, item->vx, item->vy - item->vy * dt / ITEM_FADE_SPEED);
+        setSpeed(item, item->vx, item->vy - fixedMul(item->vy, fade));
         move(item, HITTEST_NONE);
 
     } else {
@@ -368,10 +479,10 @@ void Fireball_onInit( Object* e )
 void Fireball_onFrame( Object* e )
 {
     if (e->state <= FIREBALL_MOVING) {
-        if (isVisible(e, (Object*)&player)) {
+        if (isVisible(e, (Object*)player)) {
             Object* shot = createObject(level, TYPE_FIRESHOT, 0, 0);
-            shot->x = e->anim.flip & SDL_FLIP_HORIZONTAL ? e->x - shot->type->sprite.w : e->x + e->type->sprite.w;
-            shot->y = e->y + 2;
+            shot->x = e->anim.flip & SDL_FLIP_HORIZONTAL ? e->x - intToFixed(shot->type->sprite.w) : e->x + intToFixed(e->type->sprite.w);
+            shot->y = e->y + intToFixed(2);
             setSpeed(shot, shot->vx * (e->vx > 0 ? 1 : -1), shot->vy);
             e->state = FIREBALL_MOVING + 1;
         }
@@ -395,10 +506,10 @@ void Fireball_onFrame( Object* e )
     const int dt = getElapsedFrameTime();
     e->data -= dt;
     if (e->data < 0) {
-        if (rand() % 10 == 9) {
+        if (getObjectRandom(e) % 10 == 9) {
             setSpeed(e, -e->vx, e->vy);
         }
-        if (rand() % 10 == 9) {
+        if (getObjectRandom(e) % 10 == 9) {
             setSpeed(e, e->vx, -e->vy);
         }
         e->data = 1000;
@@ -416,7 +527,7 @@ static const int DROP_FELL = 5000;
 
 void Drop_onInit( Object* e )
 {
-    e->state = -rand() % 2000;
+    e->state = -getObjectRandom(e) % 2000;
 }
 
 void Drop_onFrame( Object* e )
@@ -425,6 +536,8 @@ void Drop_onFrame( Object* e )
         e->state += getElapsedFrameTime();
         if (e->state > DROP_CREATE) {
             e->state = DROP_CREATE;
+        } else {
+            sleepUntilState(e, DROP_WAITING + 1);
         }
 
     } else if (e->state <= DROP_CREATE) {
@@ -432,14 +545,15 @@ void Drop_onFrame( Object* e )
         drop->x = e->x;
         drop->y = e->y;
         drop->state = DROP_FALLING;
-        e->state = DROP_WAITING - 2000 - rand() % 8000;
+        e->state = DROP_WAITING - 2000 - getObjectRandom(e) % 8000;
 
     } else if (e->state <= DROP_FALLING) {
-        if (e->vy < 120) {
-            e->vy += 48 * getElapsedFrameTime() / 1000.0;
+        if (e->vy < intToFixed(120)) {
+            e->vy += fixedMul(intToFixed(48), getElapsedFrameSeconds());
         }
         if (move(e, HITTEST_WALLS | HITTEST_LEVEL)) {
             move(e, HITTEST_NONE);
+            emitEffect(e, EFFECT_SPLASH);
             e->state = DROP_FALLING + 1;
         }
 
@@ -468,10 +582,10 @@ void Spider_onFrame( Object* e )
 {
     MovingEnemy_onFrame(e);
 
-    if (rand() % 100 == 99) {
+    if (getObjectRandom(e) % 100 == 99) {
         const int direction = e->vx > 0 ? 1 : -1;
-        if (fabs(e->vx) == e->type->speed) {
-            setSpeed(e, direction * e->type->speed * 2.5, e->vy);
+        if (fixedAbs(e->vx) == e->type->speed) {
+            setSpeed(e, direction * e->type->speed * 5 / 2, e->vy);
         } else {
             setSpeed(e, direction * e->type->speed, e->vy);
         }
@@ -487,7 +601,7 @@ static const int TELEPORTINGENEMY_AFTER_TELEPORT = 9000;
 void TeleportingEnemy_onFrame( Object* e )
 {
     if (e->state <= TELEPORTINGENEMY_MOVING) {
-        if (move(e, HITTEST_ALL)) {
+        if (patrol(e)) {
             setSpeed(e, -e->vx, e->vy);
         }
         setAnimation(e, 1, 2, speedToFps(e->vx));
@@ -500,21 +614,11 @@ void TeleportingEnemy_onFrame( Object* e )
         }
 
     } else if (e->state <= TELEPORTINGENEMY_TELEPORT) {
-        const int currentRow = (e->y + CELL_HALF) / CELL_SIZE;
-        for (int i = 0; i < CELL_COUNT; i++) {
-            const int r = rand() % (ROW_COUNT - 1);
-            const int c = rand() % COLUMN_COUNT;
-            if (r == currentRow) {
-                continue;
-            }
-            const int canStand     = !isSolid(r, c,     SOLID_ALL)   && isSolid(r + 1, c,     SOLID_TOP);
-            const int canMoveLeft  = !isSolid(r, c - 1, SOLID_RIGHT) && isSolid(r + 1, c - 1, SOLID_TOP);
-            const int canMoveRight = !isSolid(r, c + 1, SOLID_LEFT)  && isSolid(r + 1, c + 1, SOLID_TOP);
-            if (canStand && (canMoveLeft || canMoveRight)) {
-                e->y = CELL_SIZE * r;
-                e->x = CELL_SIZE * c;
-                break;
-            }
+        const int currentRow = (fixedToInt(e->y) + CELL_HALF) / CELL_SIZE;
+        int r, c;
+        if (findSpot(currentRow, getObjectRandom(e), &r, &c)) {
+            e->y = intToFixed(CELL_SIZE * r);
+            e->x = intToFixed(CELL_SIZE * c);
         }
         e->state = TELEPORTINGENEMY_TELEPORT + 1;
         e->anim.alpha = 0;
@@ -526,7 +630,7 @@ void TeleportingEnemy_onFrame( Object* e )
         }
 
     } else {
-        e->state = -rand() % 2000;
+        e->state = -getObjectRandom(e) % 2000;
         e->anim.alpha = 255;
     }
 
@@ -556,13 +660,13 @@ void Platform_onFrame( Object* e )
 
 void Platform_onHit( Object* e )
 {
-    const double dt = getElapsedFrameTime() / 1000.0;
-    const double dw = (CELL_SIZE - player.type->body.w) / 2.0;
-    const double dh = (CELL_SIZE - player.type->body.h) / 2.0;
-    const double border = 3;
+    const Fixed dt = getElapsedFrameSeconds();
+    const Fixed dw = intToFixed(CELL_SIZE - player->type->body.w) / 2;
+    const Fixed dh = intToFixed(CELL_SIZE - player->type->body.h) / 2;
+    const Fixed border = intToFixed(3);
 
     Borders pb, eb;
-    getObjectBody((Object*)&player, &pb);
+    getObjectBody((Object*)player, &pb);
     getObjectBody(e, &eb);
 
     const int hitX = pb.right >= (eb.left + border) && pb.left <= (eb.right - border);
@@ -570,43 +674,51 @@ void Platform_onHit( Object* e )
 
     // Top
     if (pb.bottom > eb.top && pb.bottom < eb.bottom && hitX) {
-        if (!player.vx) {
-            player.x += e->vx * dt;
+        if (!player->vx) {
+            player->x += fixedMul(e->vx, dt);
         }
-        player.y = eb.top - dh - player.type->body.h;
-        player.inAir = 0;
+        player->y = eb.top - dh - intToFixed(player->type->body.h);
+        player->inAir = 0;
     // Bottom
     } else if (pb.top < eb.bottom && pb.top > eb.top && hitX) {
-        player.y = eb.bottom - dh;
+        player->y = eb.bottom - dh;
     // Left
     } else if (pb.right > eb.left && pb.right < eb.right && hitY) {
-        player.x = eb.left - dw - player.type->body.w;
+        player->x = eb.left - dw - intToFixed(player->type->body.w);
     // Right
     } else if (pb.left < eb.right && pb.left > eb.left && hitY) {
-        player.x = eb.right - dw;
+        player->x = eb.right - dw;
     }
 }
 
 
+static const int SPRING_IDLE = 0;
+static const int SPRING_PRESSED = 1000;
+
 void Spring_onInit( Object* e )
 {
 }
 
 void Spring_onFrame( Object* e )
 {
-    if (e->state > 0) {
-        e->state -= getElapsedFrameTime();
+    if (e->state <= SPRING_IDLE) {
+        sleepObject(e, 0);
+
+    } else if (e->state <= SPRING_PRESSED) {
+        e->state += getElapsedFrameTime();
+        sleepUntilState(e, SPRING_PRESSED + 1);
+
     } else {
         setAnimation(e, 0, 0, 0);
-        e->state = 0;
+        e->state = SPRING_IDLE;
     }
 }
 
 void Spring_onHit( Object* e )
 {
-    if (e->state == 0 && player.vy > 48) {
-        player.vy = -15 * 24;
-        e->state = 1000;
+    if (e->state <= SPRING_IDLE && player->vy > intToFixed(48)) {
+        player->vy = intToFixed(-15 * 24);
+        e->state = SPRING_IDLE + 1;
         setAnimation(e, 1, 1, 0);
     }
 }
@@ -614,11 +726,11 @@ void Spring_onHit( Object* e )
 
 void Cloud_onHit( Object* e )
 {
-    if (player.y + CELL_HALF < e->y + CELL_SIZE) {
-        if (player.vy > 0) {
-            player.y -= player.vy * 0.9 * getElapsedFrameTime() / 1000.0;
+    if (player->y + intToFixed(CELL_HALF) < e->y + intToFixed(CELL_SIZE)) {
+        if (player->vy > 0) {
+            player->y -= fixedMul(fixedMul(player->vy, FIXED(0.9)), getElapsedFrameSeconds());
         }
-        player.inAir = 0;
+        player->inAir = 0;
     }
 }
 
@@ -644,7 +756,7 @@ void Water_onHit( Object* e )
     getObjectCell(e, &er, &ec);
 
     int pr, pc;
-    getObjectCell((Object*)&player, &pr, &pc);
+    getObjectCell((Object*)player, &pr, &pc);
 
     if (er == pr) {
         killPlayer();
@@ -0,0 +1,129 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "pack.h"
+#include <string.h>
+
+#ifdef _WIN32
+#include "memory.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const Uint8* pack;
+static size_t packSize;
+
+
+// Where there's no mmap(), the pack is read into memory
+static const Uint8* mapFile( const char* path, size_t* size )
+{
+#ifdef _WIN32
+    SDL_RWops* file = SDL_RWFromFile(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+    *size = SDL_RWsize(file);
+    Uint8* data = (Uint8*)allocMemory(MEMORY_FONTS, *size);
+    if (SDL_RWread(file, data, 1, *size) != *size) {
+        freeMemory(MEMORY_FONTS, data, *size);
+        data = NULL;
+    }
+    SDL_RWclose(file);
+    return data;
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        *size = st.st_size;
+        data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd); // The mapping stays
+    return data != MAP_FAILED ? (const Uint8*)data : NULL;
+#endif
+}
+
+static void unmapFile( const Uint8* data, size_t size )
+{
+#ifdef _WIN32
+    freeMemory(MEMORY_FONTS, (void*)data, size);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+// The header and the entries are checked once here, so the lookups can trust them
+static int isPackValid( const Uint8* data, size_t size )
+{
+    const PackHeader* header = (const PackHeader*)data;
+    if (size < sizeof(PackHeader) || memcmp(header->magic, PACK_MAGIC, 4) != 0 ||
+        header->version != PACK_VERSION || header->size != size ||
+        header->entryCount > (size - sizeof(PackHeader)) / sizeof(PackEntry)) {
+        return 0;
+    }
+    const PackEntry* entries = (const PackEntry*)(header + 1);
+    for (Uint32 i = 0; i < header->entryCount; ++ i) {
+        const PackEntry* entry = &entries[i];
+        if (entry->offset > size || entry->size > size - entry->offset ||
+            entry->offset % PACK_ALIGN != 0 || entry->name[PACK_NAME_SIZE - 1] != 0 ||
+            (entry->type == PACK_ENTRY_IMAGE && entry->size != (Uint32)entry->width * entry->height * 4)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int openPack( const char* path )
+{
+    closePack();
+    size_t size = 0;
+    const Uint8* data = mapFile(path, &size);
+    if (!data) {
+        return 0;
+    }
+    if (!isPackValid(data, size)) {
+        unmapFile(data, size);
+        return 0;
+    }
+    pack = data;
+    packSize = size;
+    return 1;
+}
+
+void closePack()
+{
+    if (pack) {
+        unmapFile(pack, packSize);
+        pack = NULL;
+        packSize = 0;
+    }
+}
+
+const PackEntry* findPackEntry( const char* name )
+{
+    if (!pack) {
+        return NULL;
+    }
+    const PackHeader* header = (const PackHeader*)pack;
+    const PackEntry* entries = (const PackEntry*)(header + 1);
+    for (Uint32 i = 0; i < header->entryCount; ++ i) {
+        if (strcmp(entries[i].name, name) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+const void* getPackData( const PackEntry* entry )
+{
+    return pack + entry->offset;
+}
@@ -0,0 +1,64 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef PACK_H
+#define PACK_H
+
+#include "types.h"
+
+// The asset pack is one file with the assets the game loads at start, made
+// by tools/genpack.c at build time. The pack is mapped into memory, and each
+// asset is found by its source path, so the game uses the pack if it's there
+// and the separate files otherwise. The images are stored already converted:
+// as PACK_PIXEL_FORMAT pixels with alpha instead of the color key, so they are
+// uploaded to the textures as is. The numbers are in the byte order of the
+// machine that built the pack.
+//
+//   PackHeader
+//   PackEntry[entryCount]
+//   data of the entries, each aligned to PACK_ALIGN bytes
+
+#define PACK_MAGIC "SDLP"
+#define PACK_PATH "assets.pack"
+
+enum
+{
+    PACK_VERSION = 1,
+    PACK_NAME_SIZE = 48,
+    PACK_ALIGN = 16,
+    PACK_PIXEL_FORMAT = SDL_PIXELFORMAT_ARGB8888 // Native for the most renderers
+};
+
+typedef enum
+{
+    PACK_ENTRY_RAW = 0,     // File as is
+    PACK_ENTRY_IMAGE        // Pixels, width * 4 bytes per row
+} PackEntryType;
+
+typedef struct
+{
+    char magic[4];
+    Uint32 version;
+    Uint32 entryCount;
+    Uint32 size;            // Of the whole pack
+} PackHeader;
+
+typedef struct
+{
+    char name[PACK_NAME_SIZE]; // Source path, 0-terminated
+    Uint32 type;
+    Uint32 offset;          // From the pack beginning
+    Uint32 size;
+    Uint16 width;           // Images only
+    Uint16 height;
+} PackEntry;
+
+int openPack( const char* path );   // Returns 0 if there's no valid pack
+void closePack();                   // The data of the entries is not valid after it
+const PackEntry* findPackEntry( const char* name ); // NULL if the pack is not open or has no such entry
+const void* getPackData( const PackEntry* entry );
+
+#endif
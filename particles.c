@@ -0,0 +1,162 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "particles.h"
+#include "render.h"
+#include "game.h"
+#include <math.h>
+
+enum { PARTICLE_CAPACITY = 4096 };
+
+typedef struct
+{
+    int count;
+    float speed;            // Pixels per second, the maximum
+    float angle;            // Direction spread around up, radians
+    float gravity;          // Pixels per second per second
+    float fade;             // Alpha per second
+    int size;               // Pixels
+    SDL_Color color;
+} Effect;
+
+static const Effect EFFECTS[EFFECT_COUNT] = {
+    [EFFECT_SPLASH]      = {8,  60, 1.2f, 480, 400, 1, {120, 170, 255, 255}},
+    [EFFECT_SPARKLES]    = {12, 40, 3.2f, 0,   320, 1, {255, 240, 140, 255}},
+    [EFFECT_ICE_DEBRIS]  = {10, 70, 3.2f, 360, 360, 1, {170, 230, 255, 255}},
+    [EFFECT_FIRE_DEBRIS] = {10, 70, 3.2f, 360, 360, 1, {255, 160, 60,  255}}
+};
+
+// Structure of arrays, so the update loops can be vectorized
+static struct
+{
+    float x[PARTICLE_CAPACITY];
+    float y[PARTICLE_CAPACITY];
+    float vx[PARTICLE_CAPACITY];
+    float vy[PARTICLE_CAPACITY];
+    float gravity[PARTICLE_CAPACITY];
+    float alpha[PARTICLE_CAPACITY];
+    float fade[PARTICLE_CAPACITY];
+    Uint8 effect[PARTICLE_CAPACITY];
+    int count;
+    Uint32 random;
+} particles;
+
+static SDL_Vertex vertices[PARTICLE_CAPACITY * 4];
+static int indices[PARTICLE_CAPACITY * 6];
+static __thread int enabled = 0;
+
+
+// Own random generator, because the particles must not change the game state.
+// Returns a number in [0; 1).
+static float randomFloat()
+{
+    particles.random = particles.random * 1664525 + 1013904223;
+    return (particles.random >> 8) / (float)(1 << 24);
+}
+
+// Enables the particles in the calling thread
+void initParticles()
+{
+    for (int i = 0; i < PARTICLE_CAPACITY; ++ i) {
+        int* index = &indices[i * 6];
+        index[0] = i * 4;
+        index[1] = i * 4 + 1;
+        index[2] = i * 4 + 2;
+        index[3] = i * 4;
+        index[4] = i * 4 + 2;
+        index[5] = i * 4 + 3;
+    }
+    particles.count = 0;
+    particles.random = 1;
+    enabled = 1;
+}
+
+// If there is no room, the particles are not emitted
+void emitParticles( EffectId effect, int x, int y )
+{
+    if (!enabled) {
+        return;
+    }
+
+    const Effect* e = &EFFECTS[effect];
+    for (int n = 0; n < e->count && particles.count < PARTICLE_CAPACITY; ++ n) {
+        const int i = particles.count ++;
+        const float angle = (randomFloat() - 0.5f) * e->angle;
+        const float speed = e->speed * (0.3f + 0.7f * randomFloat());
+        particles.x[i] = x;
+        particles.y[i] = y;
+        particles.vx[i] = sinf(angle) * speed;
+        particles.vy[i] = -cosf(angle) * speed;
+        particles.gravity[i] = e->gravity;
+        particles.alpha[i] = 255;
+        particles.fade[i] = e->fade * (0.7f + 0.6f * randomFloat());
+        particles.effect[i] = effect;
+    }
+}
+
+void clearParticles()
+{
+    if (enabled) {
+        particles.count = 0;
+    }
+}
+
+void updateParticles( float dt )
+{
+    const int count = particles.count;
+    for (int i = 0; i < count; ++ i) {
+        particles.vy[i] += particles.gravity[i] * dt;
+    }
+    for (int i = 0; i < count; ++ i) {
+        particles.x[i] += particles.vx[i] * dt;
+        particles.y[i] += particles.vy[i] * dt;
+        particles.alpha[i] -= particles.fade[i] * dt;
+    }
+
+    // Remove the faded and fallen ones, moving the last particle to the place
+    const float bottom = level->rows * CELL_SIZE;
+    for (int i = 0; i < particles.count;) {
+        if (particles.alpha[i] <= 0 || particles.y[i] > bottom) {
+            const int last = -- particles.count;
+            particles.x[i] = particles.x[last];
+            particles.y[i] = particles.y[last];
+            particles.vx[i] = particles.vx[last];
+            particles.vy[i] = particles.vy[last];
+            particles.gravity[i] = particles.gravity[last];
+            particles.alpha[i] = particles.alpha[last];
+            particles.fade[i] = particles.fade[last];
+            particles.effect[i] = particles.effect[last];
+        } else {
+            ++ i;
+        }
+    }
+}
+
+void drawParticles( int originX, int originY )
+{
+    static const float corners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+    if (particles.count == 0) {
+        return;
+    }
+    for (int i = 0; i < particles.count; ++ i) {
+        const Effect* e = &EFFECTS[particles.effect[i]];
+        SDL_Color color = e->color;
+        color.a = (Uint8)particles.alpha[i];
+        const float x = floorf(particles.x[i]) + originX;
+        const float y = floorf(particles.y[i]) + originY;
+
+        SDL_Vertex* vertex = &vertices[i * 4];
+        for (int v = 0; v < 4; ++ v) {
+            vertex[v].position.x = x + corners[v][0] * e->size;
+            vertex[v].position.y = y + corners[v][1] * e->size;
+            vertex[v].color = color;
+        }
+    }
+
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(renderer, NULL, vertices, particles.count * 4, indices, particles.count * 6);
+}
@@ -0,0 +1,31 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include "types.h"
+
+// Particles are visual effects which are not objects: they don't collide, are
+// not a part of the game state and are drawn with one batch. They exist only
+// where the rendering is initialized, so the headless game instances skip them.
+
+typedef enum
+{
+    EFFECT_SPLASH = 0,
+    EFFECT_SPARKLES,
+    EFFECT_ICE_DEBRIS,
+    EFFECT_FIRE_DEBRIS,
+    EFFECT_COUNT
+} EffectId;
+
+void initParticles();
+void emitParticles( EffectId effect, int x, int y ); // Level pixels
+void clearParticles();
+void updateParticles( float dt );                    // Seconds
+void drawParticles( int x, int y );                  // Level origin on the screen
+
+#endif
@@ -8,85 +8,272 @@
 #include "game.h"
 #include "framecontrol.h"
 #include "helpers.h"
+#include "particles.h"
+#include "memory.h"
+#include "minimap.h"
+#include "levels.h"
+#include "pack.h"
 #include "SDL_ttf.h"
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 
 SDL_Renderer* renderer;
 static SDL_Texture* sprites;
 static SDL_Window* window;
+static SDL_Texture* screen;     // Render target at the level resolution
 static TTF_Font* font;
 static SDL_Texture* messages[MESSAGE_COUNT];
 
+// Glyph atlas: the printable ASCII chars rendered once in a row
+enum
+{
+    GLYPH_FIRST = ' ',
+    GLYPH_LAST = '~',
+    GLYPH_COUNT = GLYPH_LAST - GLYPH_FIRST + 1,
+    HUD_TEXT_SIZE = 64
+};
+
+static SDL_Texture* glyphs;
+static SDL_Rect glyphRects[GLYPH_COUNT];
+static float glyphAtlasWidth;
+static float glyphAtlasHeight;
+
+// HUD quads, rebuilt only when the shown values change
+static struct
+{
+    int values[4];
+    int valid;
+    SDL_Vertex vertices[HUD_TEXT_SIZE * 4];
+    int indices[HUD_TEXT_SIZE * 6];
+    int glyphCount;
+} hud;
+
 static const SDL_Color TEXT_COLOR = {255, 255, 255, 255};
 static const SDL_Color TEXT_BOX_CONTENT_COLOR = {0, 0, 0, 255};
 static const SDL_Color TEXT_BOX_BORDER_COLOR = {255, 255, 255, 255};
-static const int TEXT_BOX_BORDER = 1 * SIZE_FACTOR;
-static const int TEXT_BOX_PADDING = 5 * SIZE_FACTOR;
-static const int TEXT_FONT_SIZE = 8 * SIZE_FACTOR;
+static const int TEXT_BOX_BORDER = 1;
+static const int TEXT_BOX_PADDING = 5;
+static const int TEXT_FONT_SIZE = 8;
+static const int HUD_MARGIN = 4;
+
+static const double CAMERA_FOLLOW_SPEED = 6;  // Part of the distance to the target per second, for small dt
+static const int CAMERA_SNAP_DISTANCE = LEVEL_WIDTH / 2; // Pixels, farther targets (respawn) are not scrolled to
+
+// Scrolling camera, in world pixels (the level (r, c) begins at c * LEVEL_WIDTH,
+// r * LEVEL_HEIGHT). When disabled, the current level is shown as is.
+static struct
+{
+    int enabled;
+    int valid;
+    double x;
+    double y;
+} camera;
 
 
+// Counts the texture memory, 4 bytes per pixel
+static SDL_Texture* trackTexture( SDL_Texture* texture )
+{
+    int w = 0, h = 0;
+    if (texture) {
+        SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+        trackMemory(MEMORY_TEXTURES, (long long)w * h * 4);
+    }
+    return texture;
+}
+
 // The text must be one-line
 static void initMessage( MessageId id, const char* text )
 {
     SDL_Surface* surface = TTF_RenderText_Solid(font, text, TEXT_COLOR);
-    messages[id] = SDL_CreateTextureFromSurface(renderer, surface);
+    messages[id] = trackTexture(SDL_CreateTextureFromSurface(renderer, surface));
     SDL_FreeSurface(surface);
 }
 
-void initRender( const char* spritesPath, const char* fontPath )
+static void initGlyphs()
+{
+    SDL_Surface* surfaces[GLYPH_COUNT];
+    int width = 0, height = 0;
+    for (int i = 0; i < GLYPH_COUNT; ++ i) {
+        surfaces[i] = TTF_RenderGlyph_Solid(font, GLYPH_FIRST + i, TEXT_COLOR);
+        ensure(surfaces[i] != NULL, "initGlyphs(): Can't render glyph");
+        glyphRects[i] = (SDL_Rect){width, 0, surfaces[i]->w, surfaces[i]->h};
+        width += surfaces[i]->w;
+        height = surfaces[i]->h > height ? surfaces[i]->h : height;
+    }
+
+    SDL_Surface* atlas = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+    ensure(atlas != NULL, "initGlyphs(): Can't create glyph atlas");
+    SDL_FillRect(atlas, NULL, SDL_MapRGBA(atlas->format, 0, 0, 0, 0));
+    glyphAtlasWidth = width;
+    glyphAtlasHeight = height;
+    for (int i = 0; i < GLYPH_COUNT; ++ i) {
+        SDL_BlitSurface(surfaces[i], NULL, atlas, &glyphRects[i]);
+        SDL_FreeSurface(surfaces[i]);
+    }
+    glyphs = trackTexture(SDL_CreateTextureFromSurface(renderer, atlas));
+    SDL_SetTextureBlendMode(glyphs, SDL_BLENDMODE_BLEND);
+    SDL_FreeSurface(atlas);
+}
+
+// Creates the sprites texture and returns the sprite sheet surface. The pack
+// has the pixels ready for the texture, the file is converted with the color
+// key by SDL.
+static SDL_Surface* loadSprites( const char* path )
+{
+    SDL_Surface* surface;
+    const PackEntry* entry = findPackEntry(path);
+    if (entry && entry->type == PACK_ENTRY_IMAGE) {
+        void* pixels = (void*)getPackData(entry);
+        surface = SDL_CreateRGBSurfaceWithFormatFrom(pixels, entry->width, entry->height, 32, entry->width * 4, PACK_PIXEL_FORMAT);
+        sprites = trackTexture(SDL_CreateTexture(renderer, PACK_PIXEL_FORMAT, SDL_TEXTUREACCESS_STATIC, entry->width, entry->height));
+        ensure(surface != NULL && sprites != NULL, "initRender(): Can't create sprites texture");
+        SDL_UpdateTexture(sprites, NULL, pixels, entry->width * 4);
+        SDL_SetTextureBlendMode(sprites, SDL_BLENDMODE_BLEND);
+    } else {
+        surface = SDL_LoadBMP(path);
+        ensure(surface != NULL,  "initRender(): Can't load sprite sheet");
+        SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, SPRITES_COLOR_KEY.r, SPRITES_COLOR_KEY.g, SPRITES_COLOR_KEY.b));
+        sprites = trackTexture(SDL_CreateTextureFromSurface(renderer, surface));
+    }
+    return surface;
+}
+
+// The game is drawn at the level resolution into the screen texture, which
+// is then scaled to the window with one copy, see presentFrame(). The assets
+// are taken from the asset pack if it's open (see pack.h).
+void initRender( const char* spritesPath, const char* fontPath, int scale, int fullscreen )
 {
     // Window and renderer
-    SDL_CreateWindowAndRenderer(LEVEL_WIDTH * SIZE_FACTOR, LEVEL_HEIGHT * SIZE_FACTOR, 0, &window, &renderer);
+    scale = scale < 1 ? 1 : scale > MAX_SCALE ? MAX_SCALE : scale;
+    SDL_CreateWindowAndRenderer(LEVEL_WIDTH * scale, LEVEL_HEIGHT * scale, SDL_WINDOW_RESIZABLE, &window, &renderer);
+    ensure(window != NULL && renderer != NULL, "initRender(): Can't create window");
+    setFullscreen(fullscreen);
+
+    // Screen
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+    screen = trackTexture(SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, LEVEL_WIDTH, LEVEL_HEIGHT));
+    ensure(screen != NULL, "initRender(): Can't create screen texture");
 
     // Sprites
-    static const Uint8 transparent[3] = {90, 82, 104};
-    SDL_Surface* surface = SDL_LoadBMP(spritesPath);
-    ensure(surface != NULL,  "initRender(): Can't load sprite sheet");
-    SDL_SetColorKey(surface, SDL_TRUE, SDL_MapRGB(surface->format, transparent[0], transparent[1], transparent[2]));
-    sprites = SDL_CreateTextureFromSurface(renderer, surface);
+    SDL_Surface* surface = loadSprites(spritesPath);
+    initMinimap(surface, SPRITES_COLOR_KEY);
     SDL_FreeSurface(surface);
 
     // Font
     TTF_Init();
-    font = TTF_OpenFont(fontPath, TEXT_FONT_SIZE);
+    const PackEntry* fontEntry = findPackEntry(fontPath);
+    SDL_RWops* fontFile = fontEntry ? SDL_RWFromConstMem(getPackData(fontEntry), fontEntry->size)
+                                    : SDL_RWFromFile(fontPath, "rb");
+    ensure(fontFile != NULL, "initRender(): Can't open font");
+    trackMemory(MEMORY_FONTS, SDL_RWsize(fontFile));
+    font = TTF_OpenFontRW(fontFile, 1, TEXT_FONT_SIZE);
     ensure(font != NULL, "initRender(): Can't open font");
 
+    // Glyphs
+    initGlyphs();
+    hud.valid = 0;
+
+    // Particles
+    initParticles();
+
     // Messages
     initMessage(MESSAGE_PLAYER_KILLED,  "You lost a life");
     initMessage(MESSAGE_GAME_OVER,      "Game over");
     initMessage(MESSAGE_LEVEL_COMPLETE, "Level complete!");
 }
 
+void setFullscreen( int fullscreen )
+{
+    SDL_SetWindowFullscreen(window, fullscreen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+}
+
+void toggleFullscreen()
+{
+    setFullscreen(!(SDL_GetWindowFlags(window) & SDL_WINDOW_FULLSCREEN_DESKTOP));
+}
+
+void setScrollingCamera( int enabled )
+{
+    camera.enabled = enabled;
+    camera.valid = 0;
+}
+
+void beginFrame()
+{
+    SDL_SetRenderTarget(renderer, screen);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+}
+
+// Copies the screen to the window with the largest integer scale that fits
+// (up to MAX_SCALE), centered. If the window is smaller than the level, the
+// screen is scaled down to fit.
+void presentFrame()
+{
+    int width, height;
+    SDL_SetRenderTarget(renderer, NULL);
+    SDL_GetRendererOutputSize(renderer, &width, &height);
+
+    SDL_Rect dstRect;
+    int scale = SDL_min(width / LEVEL_WIDTH, height / LEVEL_HEIGHT);
+    if (scale >= 1) {
+        scale = SDL_min(scale, MAX_SCALE);
+        dstRect.w = LEVEL_WIDTH * scale;
+        dstRect.h = LEVEL_HEIGHT * scale;
+    } else if (width * LEVEL_HEIGHT < height * LEVEL_WIDTH) {
+        dstRect.w = width;
+        dstRect.h = width * LEVEL_HEIGHT / LEVEL_WIDTH;
+    } else {
+        dstRect.w = height * LEVEL_WIDTH / LEVEL_HEIGHT;
+        dstRect.h = height;
+    }
+    dstRect.x = (width - dstRect.w) / 2;
+    dstRect.y = (height - dstRect.h) / 2;
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    SDL_RenderCopy(renderer, screen, NULL, &dstRect);
+    SDL_RenderPresent(renderer);
+}
+
+// The sprite of the type in the theme of the current level
+static inline SDL_Rect getSprite( const ObjectType* type )
+{
+    return themeSprites[level->theme][type->typeId];
+}
+
 void drawSprite( SDL_Rect spriteRect, int x, int y, int frame, SDL_RendererFlip flip )
 {
     spriteRect.x += spriteRect.w * frame;
-    SDL_Rect dstRect = {x * SIZE_FACTOR, y * SIZE_FACTOR, spriteRect.w * SIZE_FACTOR, spriteRect.h * SIZE_FACTOR};
+    SDL_Rect dstRect = {x, y, spriteRect.w, spriteRect.h};
     SDL_RenderCopyEx(renderer, sprites, &spriteRect, &dstRect, 0, NULL, flip);
 }
 
-static void drawObjectBody( Object* object )
+static void drawObjectBody( Object* object, int originX, int originY )
 {
-    SDL_Rect body = {(object->x + object->type->body.x) * SIZE_FACTOR,
-                     (object->y + object->type->body.y) * SIZE_FACTOR,
-                     object->type->body.w * SIZE_FACTOR,
-                     object->type->body.h * SIZE_FACTOR};
+    SDL_Rect body = {fixedToInt(object->x) + object->type->body.x + originX,
+                     fixedToInt(object->y) + object->type->body.y + originY,
+                     object->type->body.w,
+                     object->type->body.h};
 
     SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
     SDL_RenderDrawRect(renderer, &body);
 }
 
-void drawObject( Object* object )
+// Draws the object of a level whose origin is at (originX, originY) on the screen
+static void drawObjectAt( Object* object, int originX, int originY )
 {
     const int frame = object->anim.frame;
     const int flip = object->anim.flip;
-    const int x = object->x;
-    const int y = object->y;
+    const int x = fixedToInt(object->x) + originX;
+    const int y = fixedToInt(object->y) + originY;
 
     SDL_SetTextureAlphaMod(sprites, object->anim.alpha);
 
     if (object->anim.type == ANIMATION_WAVE) {
-        SDL_Rect spriteRect = object->type->sprite;
+        SDL_Rect spriteRect = getSprite(object->type);
         spriteRect.w -= frame;
         drawSprite(spriteRect, x + frame, y, 0, flip);
 
@@ -94,16 +281,21 @@ void drawObject( Object* object )
         spriteRect.w = frame;
         drawSprite(spriteRect, x, y, 0, flip);
     } else {
-        drawSprite(object->type->sprite, x, y, frame, flip);
+        drawSprite(getSprite(object->type), x, y, frame, flip);
     }
 
 #ifdef DEBUG_MODE
-    drawObjectBody(object);
+    drawObjectBody(object, originX, originY);
 #endif
 
     SDL_SetTextureAlphaMod(sprites, 255);
 }
 
+void drawObject( Object* object )
+{
+    drawObjectAt(object, 0, 0);
+}
+
 static void drawBox( SDL_Rect box, int border, SDL_Color borderColor, SDL_Color contentColor )
 {
     const SDL_Rect borderRect = {box.x - border, box.y - border, box.w + border * 2, box.h + border * 2};
@@ -120,8 +312,8 @@ void drawMessage( MessageId id )
 
     SDL_Rect textRect = {0, 0};
     SDL_QueryTexture(texture, NULL, NULL, &textRect.w, &textRect.h);
-    textRect.x = (SIZE_FACTOR * LEVEL_WIDTH - textRect.w) / 2;
-    textRect.y = (SIZE_FACTOR * LEVEL_HEIGHT - textRect.h) / 2;
+    textRect.x = (LEVEL_WIDTH - textRect.w) / 2;
+    textRect.y = (LEVEL_HEIGHT - textRect.h) / 2;
 
     const int padding = TEXT_BOX_PADDING;
     const SDL_Rect boxRect = {textRect.x - padding, textRect.y - padding,
@@ -131,36 +323,240 @@ void drawMessage( MessageId id )
     SDL_RenderCopy(renderer, texture, NULL, &textRect);
 }
 
-void drawScreen()
+// Appends the quads of the text glyphs, returns the x after the text
+static int buildText( const char* text, int x, int y )
+{
+    static const float corners[4][2] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+
+    for (; *text && hud.glyphCount < HUD_TEXT_SIZE; ++ text) {
+        const int g = *text >= GLYPH_FIRST && *text <= GLYPH_LAST ? *text - GLYPH_FIRST : '?' - GLYPH_FIRST;
+        const SDL_Rect rect = glyphRects[g];
+
+        SDL_Vertex* vertex = &hud.vertices[hud.glyphCount * 4];
+        for (int i = 0; i < 4; ++ i) {
+            vertex[i].position.x = x + corners[i][0] * rect.w;
+            vertex[i].position.y = y + corners[i][1] * rect.h;
+            vertex[i].color = TEXT_COLOR;
+            vertex[i].tex_coord.x = (rect.x + corners[i][0] * rect.w) / glyphAtlasWidth;
+            vertex[i].tex_coord.y = corners[i][1] * rect.h / glyphAtlasHeight;
+        }
+
+        int* index = &hud.indices[hud.glyphCount * 6];
+        const int first = hud.glyphCount * 4;
+        index[0] = first;
+        index[1] = first + 1;
+        index[2] = first + 2;
+        index[3] = first;
+        index[4] = first + 2;
+        index[5] = first + 3;
+
+        hud.glyphCount += 1;
+        x += rect.w;
+    }
+    return x;
+}
+
+// Draws the player state with one batch of glyph quads
+void drawHud()
 {
-    // Level
-    for (int r = 0; r < ROW_COUNT; ++ r) {
-        for (int c = 0; c < COLUMN_COUNT; ++ c) {
-            ObjectType* type = level->cells[r][c];
-            drawSprite(type->sprite, CELL_SIZE * c, CELL_SIZE * r, 0, SDL_FLIP_NONE);
+    const int values[4] = {player->health, player->lives, player->coins, player->keys};
+    if (!hud.valid || memcmp(values, hud.values, sizeof(values)) != 0) {
+        char text[HUD_TEXT_SIZE];
+        snprintf(text, sizeof(text), "HEALTH %d  LIVES %d  COINS %d  KEYS %d",
+                 values[0], values[1], values[2], values[3]);
+        hud.glyphCount = 0;
+        buildText(text, HUD_MARGIN, HUD_MARGIN);
+        memcpy(hud.values, values, sizeof(values));
+        hud.valid = 1;
+    }
+
+    SDL_RenderGeometry(renderer, glyphs, hud.vertices, hud.glyphCount * 4, hud.indices, hud.glyphCount * 6);
+}
+
+static void updateAnimation( Animation* anim, double dt )
+{
+    anim->frameDelayCounter -= dt;
+    if (anim->frameDelayCounter <= 0) {
+        anim->frameDelayCounter = anim->frameDelay;
+        anim->frame += 1;
+        if (anim->frame > anim->frameEnd) {
+            anim->frame = anim->frameStart;
+        }
+        if (anim->type == ANIMATION_FLIP) {
+            anim->flip = anim->flip == SDL_FLIP_NONE ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
         }
     }
+}
+
+// Returns the view position on one axis which centers the target, but doesn't
+// leave the world if it's larger than the view
+static int getCenteredView( int target, int worldSize, int viewSize )
+{
+    if (worldSize <= viewSize) {
+        return (worldSize - viewSize) / 2;
+    }
+    const int position = target - viewSize / 2;
+    return position < 0 ? 0 : position > worldSize - viewSize ? worldSize - viewSize : position;
+}
+
+// Returns the offset of the view-sized page of the level which contains the
+// position. The last page is aligned to the level end.
+static int getPage( int position, int levelSize, int viewSize )
+{
+    if (levelSize <= viewSize) {
+        return (levelSize - viewSize) / 2;
+    }
+    const int page = position < 0 ? 0 : position / viewSize * viewSize;
+    return page > levelSize - viewSize ? levelSize - viewSize : page;
+}
+
+// Moves the camera towards the player, so that the player is centered unless
+// the view would leave the world
+static void updateCamera( int playerX, int playerY, double dt )
+{
+    int worldWidth, worldHeight;
+    getWorldSize(&worldWidth, &worldHeight);
+    const double x = getCenteredView(playerX, worldWidth, LEVEL_WIDTH);
+    const double y = getCenteredView(playerY, worldHeight, LEVEL_HEIGHT);
+
+    if (!camera.valid || fabs(x - camera.x) > CAMERA_SNAP_DISTANCE || fabs(y - camera.y) > CAMERA_SNAP_DISTANCE) {
+        camera.x = x;
+        camera.y = y;
+        camera.valid = 1;
+    } else {
+        const double k = 1 - exp(-CAMERA_FOLLOW_SPEED * dt);
+        camera.x += (x - camera.x) * k;
+        camera.y += (y - camera.y) * k;
+    }
+}
+
+// Returns the view position in world pixels. Without the scrolling camera, it's
+// the screen-sized page of the current level where the player is.
+static void getView( double dt, int* x, int* y )
+{
+    int originX, originY;
+    getLevelOrigin(level, &originX, &originY);
+    const int playerX = fixedToInt(player->x) + CELL_HALF;
+    const int playerY = fixedToInt(player->y) + CELL_HALF;
+    if (camera.enabled) {
+        updateCamera(originX + playerX, originY + playerY, dt);
+        *x = (int)floor(camera.x);
+        *y = (int)floor(camera.y);
+    } else {
+        *x = originX + getPage(playerX, level->columns * CELL_SIZE, LEVEL_WIDTH);
+        *y = originY + getPage(playerY, level->rows * CELL_SIZE, LEVEL_HEIGHT);
+    }
+}
+
+// The level cells which intersect the screen, if the level origin is at (x, y)
+static int getVisibleCells( const Level* level, int x, int y, int* r0, int* c0, int* r1, int* c1 )
+{
+    if (x >= LEVEL_WIDTH || x + level->columns * CELL_SIZE <= 0 ||
+        y >= LEVEL_HEIGHT || y + level->rows * CELL_SIZE <= 0) {
+        return 0;
+    }
+    *c0 = x < 0 ? -x / CELL_SIZE : 0;
+    *r0 = y < 0 ? -y / CELL_SIZE : 0;
+    *c1 = SDL_min((LEVEL_WIDTH - 1 - x) / CELL_SIZE, level->columns - 1);
+    *r1 = SDL_min((LEVEL_HEIGHT - 1 - y) / CELL_SIZE, level->rows - 1);
+    return 1;
+}
 
-    // Objects
+// Draws the screen-sized part of the current level, or with the scrolling
+// camera the parts of the levels which intersect the screen. Only the visible
+// cells and the objects of the visible chunks are passed, so it costs about
+// the same as one screen.
+void drawScreen()
+{
     const double dt = getElapsedFrameTime() / 1000.0;
-    for (int i = 0; i < level->objects.count; ++ i) {
-        Object* object = level->objects.array[i];
-        Animation* anim = &object->anim;
-        if (object->removed) {
-            continue;
+    int viewX, viewY;
+    getView(dt, &viewX, &viewY);
+
+    // Visible levels and their origins on the screen
+    struct { Level* level; int x, y; int r0, c0, r1, c1; } visible[LEVEL_COUNTY * LEVEL_COUNTX];
+    int visibleCount = 0;
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            Level* visibleLevel = &levels[lr][lc];
+            if (!camera.enabled && visibleLevel != level) {
+                continue;
+            }
+            int x, y;
+            getLevelOrigin(visibleLevel, &x, &y);
+            x -= viewX;
+            y -= viewY;
+            if (getVisibleCells(visibleLevel, x, y, &visible[visibleCount].r0, &visible[visibleCount].c0,
+                                &visible[visibleCount].r1, &visible[visibleCount].c1)) {
+                visible[visibleCount].level = visibleLevel;
+                visible[visibleCount].x = x;
+                visible[visibleCount].y = y;
+                visibleCount += 1;
+            }
+        }
+    }
+
+    // Levels
+    for (int i = 0; i < visibleCount; ++ i) {
+        const Level* visibleLevel = visible[i].level;
+        for (int r = visible[i].r0; r <= visible[i].r1; ++ r) {
+            for (int c = visible[i].c0; c <= visible[i].c1; ++ c) {
+                const SDL_Rect sprite = themeSprites[visibleLevel->theme][getCell(visibleLevel, r, c)->typeId];
+                drawSprite(sprite, visible[i].x + CELL_SIZE * c, visible[i].y + CELL_SIZE * r, 0, SDL_FLIP_NONE);
+            }
+        }
+    }
+
+    // Objects of the chunks around the visible cells, by layer. An object is
+    // in the chunk of its center, so one more chunk on each side is enough for
+    // the sprites and draw offsets. The player is in the objects of all levels,
+    // but is drawn only with the current one.
+    static ObjectArray layers[LEVEL_COUNTY * LEVEL_COUNTX][TYPE_COUNT];
+    for (int i = 0; i < visibleCount; ++ i) {
+        const Level* visibleLevel = visible[i].level;
+        const int cr0 = SDL_max((visible[i].r0 >> CHUNK_SHIFT) - 1, 0);
+        const int cc0 = SDL_max((visible[i].c0 >> CHUNK_SHIFT) - 1, 0);
+        const int cr1 = SDL_min((visible[i].r1 >> CHUNK_SHIFT) + 1, visibleLevel->chunkRows - 1);
+        const int cc1 = SDL_min((visible[i].c1 >> CHUNK_SHIFT) + 1, visibleLevel->chunkColumns - 1);
+        for (int t = 0; t < TYPE_COUNT; ++ t) {
+            layers[i][t].count = 0;
         }
-        anim->frameDelayCounter -= dt;
-        if (anim->frameDelayCounter <= 0) {
-            anim->frameDelayCounter = anim->frameDelay;
-            anim->frame += 1;
-            if (anim->frame > anim->frameEnd) {
-                anim->frame = anim->frameStart;
+        for (int cr = cr0; cr <= cr1; ++ cr) {
+            for (int cc = cc0; cc <= cc1; ++ cc) {
+                Object* object = visibleLevel->chunkObjects[cr * visibleLevel->chunkColumns + cc];
+                for (; object; object = object->nextInChunk) {
+                    ObjectArray_append(&layers[i][object->type->typeId], object);
+                }
             }
-            if (anim->type == ANIMATION_FLIP) {
-                anim->flip = anim->flip == SDL_FLIP_NONE ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE;
+        }
+        if (visibleLevel == level) {
+            ObjectArray_append(&layers[i][TYPE_PLAYER], (Object*)player);
+        }
+    }
+    for (int t = TYPE_COUNT - 1; t >= 0; -- t) {
+        for (int i = 0; i < visibleCount; ++ i) {
+            const ObjectArray* layer = &layers[i][t];
+            const int x = visible[i].x;
+            const int y = visible[i].y;
+            for (int k = 0; k < layer->count; ++ k) {
+                Object* object = layer->array[k];
+                const SDL_Rect sprite = getSprite(object->type);
+                const int left = x + fixedToInt(object->x);
+                const int top = y + fixedToInt(object->y);
+                if (left >= LEVEL_WIDTH || left + sprite.w <= 0 || top >= LEVEL_HEIGHT || top + sprite.h <= 0) {
+                    continue;
+                }
+                updateAnimation(&object->anim, dt);
+                drawObjectAt(object, x, y);
             }
         }
-        drawObject(object);
+    }
+
+    // Effects of the current level, on top of everything
+    updateParticles(dt);
+    for (int i = 0; i < visibleCount; ++ i) {
+        if (visible[i].level == level) {
+            drawParticles(visible[i].x, visible[i].y);
+        }
     }
 }
 
@@ -9,12 +9,22 @@
 
 #include "types.h"
 
+enum { MAX_SCALE = 8 };
+
+static const SDL_Color SPRITES_COLOR_KEY = {90, 82, 104, 255}; // Transparent color of the sprite sheet
+
 extern SDL_Renderer* renderer;
 
-void initRender( const char* spritesPath, const char* fontPath );
+void initRender( const char* spritesPath, const char* fontPath, int scale, int fullscreen );
+void setFullscreen( int fullscreen );
+void toggleFullscreen();
+void setScrollingCamera( int enabled );
+void beginFrame();
+void presentFrame();
 void drawSprite( SDL_Rect spriteRect, int x, int y, int frame, SDL_RendererFlip flip );
 void drawObject( Object* object );
 void drawMessage( MessageId message );
+void drawHud();
 void drawScreen();
 void setAnimation( Object* object, int frameStart, int frameEnd, int fps );
 void setAnimationWave( Object* object, int fps );
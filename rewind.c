@@ -0,0 +1,313 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "rewind.h"
+#include "snapshot.h"
+#include "helpers.h"
+#include "memory.h"
+#include <string.h>
+
+enum
+{
+    REWIND_MEMORY = 8 * 1024 * 1024,    // Bytes for the tick data
+    REWIND_MAX_TICKS = FRAME_RATE * 600,
+    KEYFRAME_PERIOD = FRAME_RATE        // Ticks between the keyframes
+};
+
+// The tick data is a snapshot (keyframe) or its XOR with the previous tick
+// snapshot, packed as the runs of (zero count, literal count, literal bytes),
+// the counts are varints
+typedef struct
+{
+    int offset;             // In the memory
+    int size;               // Packed size
+    int snapshotSize;       // Unpacked size
+    int keyframe;
+} Tick;
+
+static struct
+{
+    Uint8* memory;
+    int head;               // Offset for the next tick data
+    Tick ticks[REWIND_MAX_TICKS];
+    int first;              // Index of the oldest tick in ticks
+    int count;
+    int bytes;
+    int sinceKeyframe;
+    Snapshot previous;      // Snapshot of the last stored tick
+    Snapshot current;
+    Uint8* packed;          // Buffer for packing
+    int packedReserved;
+    double lastLatency;
+} history;
+
+
+static inline Tick* getTick( int i )
+{
+    return &history.ticks[(history.first + i) % REWIND_MAX_TICKS];
+}
+
+static Uint8* writeVarint( Uint8* out, int value )
+{
+    while (value >= 0x80) {
+        *out ++ = (Uint8)(value | 0x80);
+        value >>= 7;
+    }
+    *out ++ = (Uint8)value;
+    return out;
+}
+
+static const Uint8* readVarint( const Uint8* in, int* value )
+{
+    int shift = 0;
+    *value = 0;
+    while (*in & 0x80) {
+        *value |= (*in ++ & 0x7F) << shift;
+        shift += 7;
+    }
+    *value |= *in ++ << shift;
+    return in;
+}
+
+// Returns the packed size. The bytes of base after its size are treated as 0.
+static int packDelta( const Snapshot* base, const Snapshot* snapshot, Uint8* out )
+{
+    const Uint8* start = out;
+    int i = 0;
+    while (i < snapshot->size) {
+        int zeros = 0;
+        while (i < snapshot->size && i < base->size && snapshot->data[i] == base->data[i]) {
+            ++ zeros;
+            ++ i;
+        }
+        // The literal ends at two equal bytes, because one costs less than a new run
+        int literal = i;
+        while (literal < snapshot->size) {
+            const int same = literal < base->size && snapshot->data[literal] == base->data[literal];
+            const int sameNext = literal + 1 < base->size && literal + 1 < snapshot->size &&
+                                 snapshot->data[literal + 1] == base->data[literal + 1];
+            if (same && (sameNext || literal + 1 == snapshot->size)) {
+                break;
+            }
+            ++ literal;
+        }
+        out = writeVarint(out, zeros);
+        out = writeVarint(out, literal - i);
+        for (; i < literal; ++ i) {
+            *out ++ = snapshot->data[i] ^ (i < base->size ? base->data[i] : 0);
+        }
+    }
+    return out - start;
+}
+
+// Applies the delta to the snapshot in place
+static void unpackDelta( Snapshot* snapshot, const Uint8* in, int size, int snapshotSize )
+{
+    const Uint8* end = in + size;
+    if (snapshotSize > snapshot->reserved) {
+        snapshot->data = (Uint8*)reallocMemory(MEMORY_HISTORY, snapshot->data, snapshot->reserved, snapshotSize);
+        snapshot->reserved = snapshotSize;
+    }
+    if (snapshotSize > snapshot->size) {
+        memset(snapshot->data + snapshot->size, 0, snapshotSize - snapshot->size);
+    }
+    snapshot->size = snapshotSize;
+
+    int i = 0;
+    while (in < end) {
+        int zeros, literal;
+        in = readVarint(in, &zeros);
+        in = readVarint(in, &literal);
+        i += zeros;
+        for (; literal > 0; -- literal) {
+            snapshot->data[i ++] ^= *in ++;
+        }
+    }
+}
+
+static void setSnapshot( Snapshot* snapshot, const Uint8* data, int size )
+{
+    if (size > snapshot->reserved) {
+        snapshot->data = (Uint8*)reallocMemory(MEMORY_HISTORY, snapshot->data, snapshot->reserved, size);
+        snapshot->reserved = size;
+    }
+    memcpy(snapshot->data, data, size);
+    snapshot->size = size;
+}
+
+static void dropOldestTick()
+{
+    history.bytes -= getTick(0)->size;
+    history.first = (history.first + 1) % REWIND_MAX_TICKS;
+    history.count -= 1;
+}
+
+// The oldest tick must always be a keyframe, so the deltas left without
+// their keyframe are dropped too
+static void dropOrphanDeltas()
+{
+    while (history.count > 0 && !getTick(0)->keyframe) {
+        dropOldestTick();
+    }
+}
+
+static int overlapsOldest( int offset, int size )
+{
+    const Tick* oldest = getTick(0);
+    return offset < oldest->offset + oldest->size && oldest->offset < offset + size;
+}
+
+// Returns the place for the tick data, dropping the oldest ticks if required.
+// The data is written in a ring, and it wraps when it does not fit the end.
+// When it wraps, the ticks after the head are the oldest ones left from the
+// previous pass, and they are dropped first, so the live ticks are one arc
+// and only the oldest of them can overlap the new one.
+static Uint8* allocateTick( int size )
+{
+    if (history.head + size > REWIND_MEMORY) {
+        while (history.count > 0 && getTick(0)->offset >= history.head) {
+            dropOldestTick();
+        }
+        history.head = 0;
+    }
+    while (history.count > 0 && (history.count == REWIND_MAX_TICKS || overlapsOldest(history.head, size))) {
+        dropOldestTick();
+    }
+    dropOrphanDeltas();
+    return history.memory + history.head;
+}
+
+void initRewind()
+{
+    history.memory = (Uint8*)allocMemory(MEMORY_HISTORY, REWIND_MEMORY);
+    history.head = 0;
+    history.first = 0;
+    history.count = 0;
+    history.bytes = 0;
+    history.sinceKeyframe = 0;
+    history.packed = NULL;
+    history.packedReserved = 0;
+    history.lastLatency = 0;
+    Snapshot_init(&history.previous);
+    Snapshot_init(&history.current);
+}
+
+void freeRewind()
+{
+    freeMemory(MEMORY_HISTORY, history.memory, REWIND_MEMORY);
+    freeMemory(MEMORY_HISTORY, history.packed, history.packedReserved);
+    history.memory = NULL;
+    history.packed = NULL;
+    history.packedReserved = 0;
+    history.count = 0;
+    Snapshot_free(&history.previous);
+    Snapshot_free(&history.current);
+}
+
+// The stored ticks can't be restored after the levels are changed outside of
+// the play (e.g. reloaded), so they are dropped
+void clearRewind()
+{
+    history.head = 0;
+    history.first = 0;
+    history.count = 0;
+    history.bytes = 0;
+    history.sinceKeyframe = 0;
+}
+
+void recordTick()
+{
+    if (!history.memory) {
+        return;
+    }
+
+    saveSnapshot(&history.current);
+    int keyframe = history.count == 0 || history.sinceKeyframe + 1 >= KEYFRAME_PERIOD;
+
+    const Uint8* data = history.current.data;
+    int size = history.current.size;
+    if (!keyframe) {
+        // The worst case is a literal of every second byte
+        const int reserved = size * 2 + 16;
+        if (reserved > history.packedReserved) {
+            history.packed = (Uint8*)reallocMemory(MEMORY_HISTORY, history.packed, history.packedReserved, reserved);
+            history.packedReserved = reserved;
+        }
+        size = packDelta(&history.previous, &history.current, history.packed);
+        data = history.packed;
+    }
+    ensure(size <= REWIND_MEMORY, "recordTick(): The tick does not fit the rewind memory");
+
+    Uint8* place = allocateTick(size);
+    if (!keyframe && history.count == 0) {
+        // The keyframe of this delta was dropped to free the memory
+        keyframe = 1;
+        data = history.current.data;
+        size = history.current.size;
+        place = allocateTick(size);
+    }
+    memcpy(place, data, size);
+    Tick* tick = &history.ticks[(history.first + history.count) % REWIND_MAX_TICKS];
+    tick->offset = history.head;
+    tick->size = size;
+    tick->snapshotSize = history.current.size;
+    tick->keyframe = keyframe;
+    history.head += size;
+    history.bytes += size;
+    history.count += 1;
+    history.sinceKeyframe = tick->keyframe ? 0 : history.sinceKeyframe + 1;
+
+    // The current snapshot becomes the previous one
+    const Snapshot swap = history.previous;
+    history.previous = history.current;
+    history.current = swap;
+}
+
+// Restores the state of the last tick minus count (the oldest tick is kept),
+// decoding it from the nearest keyframe. The newer ticks are dropped, so the
+// play continues from there.
+int rewindTicks( int count )
+{
+    if (history.count < 2) {
+        return 0;
+    }
+    if (count > history.count - 1) {
+        count = history.count - 1;
+    }
+    const Uint64 start = SDL_GetPerformanceCounter();
+
+    const int target = history.count - 1 - count;
+    int keyframe = target;
+    while (!getTick(keyframe)->keyframe) {
+        -- keyframe;
+    }
+    const Tick* tick = getTick(keyframe);
+    setSnapshot(&history.previous, history.memory + tick->offset, tick->size);
+    for (int i = keyframe + 1; i <= target; ++ i) {
+        tick = getTick(i);
+        unpackDelta(&history.previous, history.memory + tick->offset, tick->size, tick->snapshotSize);
+    }
+    restoreSnapshot(&history.previous);
+
+    // Drop the newer ticks
+    for (int i = target + 1; i < history.count; ++ i) {
+        history.bytes -= getTick(i)->size;
+    }
+    history.count = target + 1;
+    history.head = getTick(target)->offset + getTick(target)->size;
+    history.sinceKeyframe = target - keyframe;
+
+    history.lastLatency = (SDL_GetPerformanceCounter() - start) * 1000000.0 / SDL_GetPerformanceFrequency();
+    return count;
+}
+
+void getRewindStats( RewindStats* stats )
+{
+    stats->ticks = history.count;
+    stats->bytes = history.bytes;
+    stats->bytesPerTick = history.count ? (double)history.bytes / history.count : 0;
+    stats->lastLatency = history.lastLatency;
+}
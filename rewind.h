@@ -0,0 +1,32 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef REWIND_H
+#define REWIND_H
+
+#include "types.h"
+
+// History of the last ticks for stepping back through the play. Each tick is
+// stored as a keyframe (full snapshot) or as a delta from the previous tick,
+// all within a fixed memory budget: when it's full, the oldest ticks are
+// dropped.
+
+typedef struct
+{
+    int ticks;              // Stored ticks
+    int bytes;              // Used bytes of the budget
+    double bytesPerTick;
+    double lastLatency;     // Time of the last rewind step, microseconds
+} RewindStats;
+
+void initRewind();
+void freeRewind();
+void clearRewind();
+void recordTick();          // Call after each processed tick
+int rewindTicks( int count ); // Restores the state count ticks back, returns the count of ticks rewound
+void getRewindStats( RewindStats* stats );
+
+#endif
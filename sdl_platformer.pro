@@ -1,7 +1,22 @@
 TEMPLATE    = app
 CONFIG      -= qt
-SOURCES     += types.c helpers.c objects.c framecontrol.c game.c levels.c main.c render.c
-HEADERS     += types.h helpers.h objects.h framecontrol.h game.h levels.h main.h render.h
+SOURCES     += types.c helpers.c objects.c framecontrol.c game.c levels.c main.c render.c navigation.c leveldata.c snapshot.c rewind.c instance.c particles.c latency.c memory.c timerwheel.c minimap.c hotreload.c pack.c trace.c
+HEADERS     += types.h helpers.h objects.h framecontrol.h game.h levels.h main.h render.h navigation.h leveldata.h snapshot.h rewind.h instance.h particles.h latency.h memory.h timerwheel.h minimap.h hotreload.h pack.h trace.h
 LIBS        += -lSDL2 -lSDL2_ttf -lm
 INCLUDEPATH += /usr/include/SDL2
-DISTFILES   += README.md LICENSE
+DISTFILES   += README.md LICENSE types.def themes.def levels.txt
+
+# Object types, theme sprites and levels are generated as constant tables
+gentables.target   = tables.c
+gentables.depends  = $$PWD/tools/gentables.c $$PWD/leveldata.c $$PWD/types.def $$PWD/themes.def $$PWD/levels.txt
+gentables.commands = cc -I$$PWD -I/usr/include/SDL2 $$PWD/tools/gentables.c $$PWD/leveldata.c -o gentables && ./gentables $$PWD/levels.txt > tables.c
+QMAKE_EXTRA_TARGETS += gentables
+PRE_TARGETDEPS      += tables.c
+SOURCES             += $$OUT_PWD/tables.c
+
+# The assets the game loads at start, in one file (see pack.h)
+genpack.target   = $$PWD/assets.pack
+genpack.depends  = $$PWD/tools/genpack.c $$PWD/pack.h $$PWD/image/sprites.bmp $$PWD/font/PressStart2P.ttf
+genpack.commands = cc -I$$PWD -I/usr/include/SDL2 $$PWD/tools/genpack.c -lSDL2 -o genpack && cd $$PWD && $$OUT_PWD/genpack assets.pack image/sprites.bmp font/PressStart2P.ttf
+QMAKE_EXTRA_TARGETS += genpack
+PRE_TARGETDEPS      += $$PWD/assets.pack
@@ -0,0 +1,331 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "snapshot.h"
+#include "game.h"
+#include "levels.h"
+#include "helpers.h"
+#include "framecontrol.h"
+#include "memory.h"
+#include <string.h>
+#include <stdio.h>
+
+// Object without the type pointer
+typedef struct
+{
+    Animation anim;
+    Fixed x;
+    Fixed y;
+    Fixed vx;
+    Fixed vy;
+    int removed;
+    int state;
+    int data;
+    Uint32 id;
+    Uint32 randomCount;
+    int sleeping;
+    int sleepTime;
+    int wakeTime;
+    Uint8 typeId;
+} ObjectRecord;
+
+// Player fields after the Object ones
+typedef struct
+{
+    int inAir;
+    int onLadder;
+    int health;
+    int invincibility;
+    int lives;
+    int coins;
+    int keys;
+} PlayerRecord;
+
+typedef struct
+{
+    const Uint8* data;
+    int position;
+} SnapshotReader;
+
+
+// Snapshot
+
+void Snapshot_init( Snapshot* snapshot )
+{
+    snapshot->data = NULL;
+    snapshot->reserved = 0;
+    snapshot->size = 0;
+}
+
+void Snapshot_free( Snapshot* snapshot )
+{
+    freeMemory(MEMORY_HISTORY, snapshot->data, snapshot->reserved);
+    Snapshot_init(snapshot);
+}
+
+// Returns the place for the next size bytes
+static void* Snapshot_append( Snapshot* snapshot, int size )
+{
+    if (snapshot->size + size > snapshot->reserved) {
+        int reserved = snapshot->reserved;
+        while (snapshot->size + size > reserved) {
+            reserved = reserved ? reserved * 2 : 4096;
+        }
+        snapshot->data = (Uint8*)reallocMemory(MEMORY_HISTORY, snapshot->data, snapshot->reserved, reserved);
+        snapshot->reserved = reserved;
+    }
+    void* place = snapshot->data + snapshot->size;
+    snapshot->size += size;
+    return place;
+}
+
+static void Snapshot_write( Snapshot* snapshot, const void* data, int size )
+{
+    memcpy(Snapshot_append(snapshot, size), data, size);
+}
+
+static const void* SnapshotReader_read( SnapshotReader* reader, int size )
+{
+    const void* data = reader->data + reader->position;
+    reader->position += size;
+    return data;
+}
+
+static void SnapshotReader_copy( SnapshotReader* reader, void* data, int size )
+{
+    memcpy(data, SnapshotReader_read(reader, size), size);
+}
+
+
+// Save
+
+static void saveObject( Snapshot* snapshot, const Object* object )
+{
+    ObjectRecord record;
+    memset(&record, 0, sizeof(record)); // The padding must be the same for the same objects
+    record.anim = object->anim;
+    record.x = object->x;
+    record.y = object->y;
+    record.vx = object->vx;
+    record.vy = object->vy;
+    record.removed = object->removed;
+    record.state = object->state;
+    record.data = object->data;
+    record.id = object->id;
+    record.randomCount = object->randomCount;
+    record.sleeping = object->sleeping;
+    record.sleepTime = object->sleepTime;
+    record.wakeTime = object->wakeTime;
+    record.typeId = object->type->typeId;
+    Snapshot_write(snapshot, &record, sizeof(record));
+}
+
+static void saveObjects( Snapshot* snapshot, const ObjectArray* objects )
+{
+    Snapshot_write(snapshot, &objects->count, sizeof(int));
+    for (int i = 0; i < objects->count; ++ i) {
+        saveObject(snapshot, objects->array[i]);
+    }
+}
+
+// Only the allocated chunks are saved, a byte per cell. The walls counts are
+// restored from the cells.
+static void saveLevel( Snapshot* snapshot, const Level* level )
+{
+    const int chunkCount = level->chunkRows * level->chunkColumns;
+    Uint8* allocated = (Uint8*)Snapshot_append(snapshot, chunkCount);
+    for (int i = 0; i < chunkCount; ++ i) {
+        allocated[i] = isChunkAllocated(level->chunks[i]);
+    }
+    for (int i = 0; i < chunkCount; ++ i) {
+        const Chunk* chunk = level->chunks[i];
+        if (isChunkAllocated(chunk)) {
+            Uint8* cells = (Uint8*)Snapshot_append(snapshot, CHUNK_SIZE * CHUNK_SIZE);
+            for (int r = 0; r < CHUNK_SIZE; ++ r) {
+                for (int c = 0; c < CHUNK_SIZE; ++ c) {
+                    *cells ++ = chunk->cells[r][c]->typeId;
+                }
+            }
+        }
+    }
+    Snapshot_write(snapshot, &level->time, sizeof(level->time));
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        saveObjects(snapshot, &level->objects.buckets[t]);
+    }
+}
+
+static void savePlayer( Snapshot* snapshot )
+{
+    saveObject(snapshot, (Object*)player);
+    const PlayerRecord record = {player->inAir, player->onLadder, player->health, player->invincibility,
+                                 player->lives, player->coins, player->keys};
+    Snapshot_write(snapshot, &record, sizeof(record));
+    saveObjects(snapshot, &player->items);
+}
+
+void saveSnapshot( Snapshot* snapshot )
+{
+    snapshot->size = 0;
+
+    saveFrameControlState(Snapshot_append(snapshot, getFrameControlStateSize()));
+    saveGameState(Snapshot_append(snapshot, getGameStateSize()));
+    const int current[2] = {level->r, level->c};
+    Snapshot_write(snapshot, current, sizeof(current));
+
+    savePlayer(snapshot);
+    for (int r = 0; r < LEVEL_COUNTY; ++ r) {
+        for (int c = 0; c < LEVEL_COUNTX; ++ c) {
+            saveLevel(snapshot, &levels[r][c]);
+        }
+    }
+}
+
+
+// Restore
+
+static void restoreObject( const ObjectRecord* record, Object* object )
+{
+    object->type = &objectTypes[record->typeId];
+    object->anim = record->anim;
+    object->x = record->x;
+    object->y = record->y;
+    object->vx = record->vx;
+    object->vy = record->vy;
+    object->removed = record->removed;
+    object->state = record->state;
+    object->data = record->data;
+    object->id = record->id;
+    object->randomCount = record->randomCount;
+    object->sleeping = record->sleeping;
+    object->sleepTime = record->sleepTime;
+    object->wakeTime = record->wakeTime;
+    object->nextSleeper = NULL;
+    object->nextTimer = NULL;
+}
+
+// The player is stored in the level buckets as well, but it's restored
+// separately, so only its place is restored here
+static void restoreObjects( SnapshotReader* reader, ObjectArray* objects )
+{
+    int count;
+    SnapshotReader_copy(reader, &count, sizeof(int));
+    for (int i = 0; i < count; ++ i) {
+        ObjectRecord record;
+        SnapshotReader_copy(reader, &record, sizeof(record));
+        if (record.typeId == TYPE_PLAYER) {
+            ObjectArray_append(objects, (Object*)player);
+        } else {
+            Object* object = allocObject(record.typeId);
+            restoreObject(&record, object);
+            ObjectArray_append(objects, object);
+        }
+    }
+}
+
+static void freeObjects( ObjectArray* objects )
+{
+    for (int i = 0; i < objects->count; ++ i) {
+        if (objects->array[i] != (Object*)player) {
+            freeObject(objects->array[i]);
+        }
+    }
+    objects->count = 0;
+}
+
+// Only the changed cells are replaced, so the navigation data and the revision
+// are kept if the cells are the same. The chunks allocated since the snapshot
+// are kept too, emptied.
+static void restoreLevel( SnapshotReader* reader, Level* level )
+{
+    const int chunkCount = level->chunkRows * level->chunkColumns;
+    const Uint8* allocated = (const Uint8*)SnapshotReader_read(reader, chunkCount);
+    for (int i = 0; i < chunkCount; ++ i) {
+        const Uint8* cells = allocated[i] ? (const Uint8*)SnapshotReader_read(reader, CHUNK_SIZE * CHUNK_SIZE) : NULL;
+        if (!cells && !isChunkAllocated(level->chunks[i])) {
+            continue;
+        }
+        const int r0 = i / level->chunkColumns * CHUNK_SIZE;
+        const int c0 = i % level->chunkColumns * CHUNK_SIZE;
+        for (int r = 0; r < CHUNK_SIZE && r0 + r < level->rows; ++ r) {
+            for (int c = 0; c < CHUNK_SIZE && c0 + c < level->columns; ++ c) {
+                createStaticObject(level, cells ? cells[r * CHUNK_SIZE + c] : TYPE_NONE, r0 + r, c0 + c);
+            }
+        }
+    }
+    SnapshotReader_copy(reader, &level->time, sizeof(level->time));
+
+    ObjectLayers* objects = &level->objects;
+    objects->count = 0;
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        freeObjects(&objects->buckets[t]);
+        restoreObjects(reader, &objects->buckets[t]);
+        objects->count += objects->buckets[t].count;
+    }
+    resetSleepers(level);
+    resetObjectChunks(level);
+}
+
+static void restorePlayer( SnapshotReader* reader )
+{
+    ObjectRecord objectRecord;
+    SnapshotReader_copy(reader, &objectRecord, sizeof(objectRecord));
+    restoreObject(&objectRecord, (Object*)player);
+    PlayerRecord record;
+    SnapshotReader_copy(reader, &record, sizeof(record));
+    player->inAir = record.inAir;
+    player->onLadder = record.onLadder;
+    player->health = record.health;
+    player->invincibility = record.invincibility;
+    player->lives = record.lives;
+    player->coins = record.coins;
+    player->keys = record.keys;
+    freeObjects(&player->items);
+    restoreObjects(reader, &player->items);
+}
+
+void restoreSnapshot( const Snapshot* snapshot )
+{
+    SnapshotReader reader = {snapshot->data, 0};
+
+    restoreFrameControlState(SnapshotReader_read(&reader, getFrameControlStateSize()));
+    restoreGameState(SnapshotReader_read(&reader, getGameStateSize()));
+    int current[2];
+    SnapshotReader_copy(&reader, current, sizeof(current));
+
+    restorePlayer(&reader);
+    for (int r = 0; r < LEVEL_COUNTY; ++ r) {
+        for (int c = 0; c < LEVEL_COUNTX; ++ c) {
+            restoreLevel(&reader, &levels[r][c]);
+        }
+    }
+    setLevel(current[0], current[1]);
+}
+
+
+// Benchmark
+
+void benchmarkSnapshot( int count )
+{
+    Snapshot snapshot;
+    Snapshot_init(&snapshot);
+
+    const double frequency = SDL_GetPerformanceFrequency() / 1000000.0;
+    Uint64 start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++ i) {
+        saveSnapshot(&snapshot);
+    }
+    const double saveTime = (SDL_GetPerformanceCounter() - start) / frequency / count;
+
+    start = SDL_GetPerformanceCounter();
+    for (int i = 0; i < count; ++ i) {
+        restoreSnapshot(&snapshot);
+    }
+    const double restoreTime = (SDL_GetPerformanceCounter() - start) / frequency / count;
+
+    printf("snapshot: %d bytes, save %.2f us, restore %.2f us (%d iterations)\n",
+           snapshot.size, saveTime, restoreTime, count);
+    Snapshot_free(&snapshot);
+}
@@ -0,0 +1,31 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "types.h"
+
+// The full game state (levels, objects, player, game loop, random state and
+// frame clock) in one contiguous buffer. The objects are stored by value with
+// type ids instead of pointers, so a snapshot can be restored any time later.
+typedef struct
+{
+    Uint8* data;
+    int reserved;
+    int size;
+} Snapshot;
+
+void Snapshot_init( Snapshot* snapshot );
+void Snapshot_free( Snapshot* snapshot );
+
+void saveSnapshot( Snapshot* snapshot );
+void restoreSnapshot( const Snapshot* snapshot );
+
+// Prints the snapshot size and the average time of save and restore
+void benchmarkSnapshot( int count );
+
+#endif
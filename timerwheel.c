@@ -0,0 +1,132 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "timerwheel.h"
+
+enum
+{
+    SLOT_BITS = 6,
+    SLOT_MASK = TIMER_WHEEL_SLOTS - 1,
+    MAX_DELAY = (1 << (SLOT_BITS * TIMER_WHEEL_LEVELS)) - 1 // Wheel ticks
+};
+
+
+// Returns the wheel tick when the object is due
+static int getDueTick( const Object* object )
+{
+    return (object->wakeTime + TIMER_WHEEL_RESOLUTION - 1) / TIMER_WHEEL_RESOLUTION;
+}
+
+// The current slot of the first level is fired after the cascading, so the
+// objects due now can be put there only while cascading
+static Object** getSlot( TimerWheel* wheel, int due, int cascading )
+{
+    const int minDelay = cascading ? 0 : 1;
+    int delay = due - wheel->now;
+    if (delay < minDelay) {
+        delay = 1; // Already due, so fires on the next tick
+        due = wheel->now + 1;
+    } else if (delay > MAX_DELAY) {
+        delay = MAX_DELAY; // Moved to the lower levels when this delay passes
+        due = wheel->now + MAX_DELAY;
+    }
+
+    int l = 0;
+    while (l < TIMER_WHEEL_LEVELS - 1 && delay >= 1 << (SLOT_BITS * (l + 1))) {
+        ++ l;
+    }
+    return &wheel->slots[l][(due >> (SLOT_BITS * l)) & SLOT_MASK];
+}
+
+void TimerWheel_init( TimerWheel* wheel, int time )
+{
+    for (int l = 0; l < TIMER_WHEEL_LEVELS; ++ l) {
+        for (int s = 0; s < TIMER_WHEEL_SLOTS; ++ s) {
+            wheel->slots[l][s] = NULL;
+        }
+    }
+    wheel->now = time / TIMER_WHEEL_RESOLUTION;
+    wheel->count = 0;
+}
+
+// The slot lists are doubly linked through timerLink, so the object is removed
+// without looking for its slot, which may differ from the one of its due tick
+static void linkTimer( Object** slot, Object* object )
+{
+    object->nextTimer = *slot;
+    if (*slot) {
+        (*slot)->timerLink = &object->nextTimer;
+    }
+    *slot = object;
+    object->timerLink = slot;
+}
+
+static void unlinkTimer( Object* object )
+{
+    *object->timerLink = object->nextTimer;
+    if (object->nextTimer) {
+        object->nextTimer->timerLink = object->timerLink;
+    }
+    object->nextTimer = NULL;
+    object->timerLink = NULL;
+}
+
+void TimerWheel_add( TimerWheel* wheel, Object* object )
+{
+    linkTimer(getSlot(wheel, getDueTick(object), 0), object);
+    wheel->count += 1;
+}
+
+void TimerWheel_remove( TimerWheel* wheel, Object* object )
+{
+    if (object->timerLink) {
+        unlinkTimer(object);
+        wheel->count -= 1;
+    }
+}
+
+// Moves the objects of the slot to the lower levels
+static void cascade( TimerWheel* wheel, int l )
+{
+    Object** slot = &wheel->slots[l][(wheel->now >> (SLOT_BITS * l)) & SLOT_MASK];
+    Object* object = *slot;
+    *slot = NULL;
+    while (object) {
+        Object* next = object->nextTimer;
+        linkTimer(getSlot(wheel, getDueTick(object), 1), object);
+        object = next;
+    }
+}
+
+void TimerWheel_advance( TimerWheel* wheel, int time, ObjectArray* due )
+{
+    const int now = time / TIMER_WHEEL_RESOLUTION;
+    while (wheel->now < now) {
+        wheel->now += 1;
+        if (wheel->count == 0) {
+            wheel->now = now;
+            break;
+        }
+
+        // When a level passes its last slot, the next slot of the upper level
+        // moves down, starting from the highest level which has passed
+        int l = 1;
+        while (l < TIMER_WHEEL_LEVELS && ((wheel->now >> (SLOT_BITS * (l - 1))) & SLOT_MASK) == 0) {
+            ++ l;
+        }
+        for (-- l; l > 0; -- l) {
+            cascade(wheel, l);
+        }
+
+        Object** slot = &wheel->slots[0][wheel->now & SLOT_MASK];
+        while (*slot) {
+            Object* object = *slot;
+            unlinkTimer(object);
+            ObjectArray_append(due, object);
+            wheel->count -= 1;
+        }
+    }
+}
@@ -0,0 +1,29 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "types.h"
+
+/*
+ * The timer wheel keeps the sleeping objects by their wake time (see
+ * sleepObject()), so that only the due ones are touched. Each level of the
+ * wheel has TIMER_WHEEL_SLOTS slots: the first level's slot is one tick of the
+ * wheel (TIMER_WHEEL_RESOLUTION ms), the next level's slot is the whole
+ * previous level, and so on. The objects due later than the first level covers
+ * are moved to the lower levels as the time comes closer.
+ *
+ * The objects are linked through nextTimer and timerLink, and are fired not
+ * before their wakeTime, but up to one wheel tick later.
+ */
+
+void TimerWheel_init( TimerWheel* wheel, int time );
+void TimerWheel_add( TimerWheel* wheel, Object* object );
+void TimerWheel_remove( TimerWheel* wheel, Object* object );
+void TimerWheel_advance( TimerWheel* wheel, int time, ObjectArray* due ); // Appends the due objects and removes them from the wheel
+
+#endif
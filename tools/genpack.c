@@ -0,0 +1,136 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+// Packs the assets into one file for the game (see pack.h). The BMP images are
+// converted to the pack pixel format, with zero alpha for the color key; the
+// other files are stored as is:
+//
+//   genpack assets.pack image/sprites.bmp font/PressStart2P.ttf
+
+#include "pack.h"
+#include "render.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    void* data;
+    Uint32 size;
+} Blob;
+
+
+static void fail( const char* message, const char* path )
+{
+    fprintf(stderr, "genpack: %s %s\n", message, path);
+    exit(1);
+}
+
+static int isImage( const char* path )
+{
+    const size_t length = strlen(path);
+    return length > 4 && SDL_strcasecmp(path + length - 4, ".bmp") == 0;
+}
+
+static Blob readFile( const char* path )
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fail("can't open", path);
+    }
+    fseek(file, 0, SEEK_END);
+    Blob blob = {NULL, (Uint32)ftell(file)};
+    fseek(file, 0, SEEK_SET);
+    blob.data = malloc(blob.size ? blob.size : 1);
+    if (fread(blob.data, 1, blob.size, file) != blob.size) {
+        fail("can't read", path);
+    }
+    fclose(file);
+    return blob;
+}
+
+// The color key pixels keep their color, so the sheet still has the same
+// colors for the minimap
+static Blob readImage( const char* path, PackEntry* entry )
+{
+    SDL_Surface* loaded = SDL_LoadBMP(path);
+    if (!loaded) {
+        fail("can't load", path);
+    }
+    SDL_Surface* surface = SDL_ConvertSurfaceFormat(loaded, PACK_PIXEL_FORMAT, 0);
+    SDL_FreeSurface(loaded);
+    if (!surface || surface->w > 0xFFFF || surface->h > 0xFFFF) {
+        fail("can't convert", path);
+    }
+
+    entry->width = surface->w;
+    entry->height = surface->h;
+    Blob blob = {malloc(surface->w * surface->h * 4), surface->w * surface->h * 4};
+    const Uint32 key = SDL_MapRGBA(surface->format, SPRITES_COLOR_KEY.r, SPRITES_COLOR_KEY.g, SPRITES_COLOR_KEY.b, 255);
+    const Uint32 transparent = SDL_MapRGBA(surface->format, SPRITES_COLOR_KEY.r, SPRITES_COLOR_KEY.g, SPRITES_COLOR_KEY.b, 0);
+    SDL_LockSurface(surface);
+    for (int y = 0; y < surface->h; ++ y) {
+        const Uint32* row = (const Uint32*)((const Uint8*)surface->pixels + y * surface->pitch);
+        Uint32* out = (Uint32*)blob.data + y * surface->w;
+        for (int x = 0; x < surface->w; ++ x) {
+            out[x] = row[x] == key ? transparent : row[x];
+        }
+    }
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+    return blob;
+}
+
+int main( int argc, char* argv[] )
+{
+    if (argc < 3) {
+        fail("usage: genpack <pack> <asset files...>", "");
+    }
+
+    const int count = argc - 2;
+    PackHeader header;
+    memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.entryCount = count;
+    PackEntry* entries = (PackEntry*)calloc(count, sizeof(PackEntry));
+    Blob* blobs = (Blob*)calloc(count, sizeof(Blob));
+
+    Uint32 offset = sizeof(PackHeader) + sizeof(PackEntry) * count;
+    for (int i = 0; i < count; ++ i) {
+        const char* path = argv[i + 2];
+        PackEntry* entry = &entries[i];
+        if (strlen(path) >= PACK_NAME_SIZE) {
+            fail("the path is too long:", path);
+        }
+        strcpy(entry->name, path);
+        entry->type = isImage(path) ? PACK_ENTRY_IMAGE : PACK_ENTRY_RAW;
+        blobs[i] = entry->type == PACK_ENTRY_IMAGE ? readImage(path, entry) : readFile(path);
+        offset = (offset + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+        entry->offset = offset;
+        entry->size = blobs[i].size;
+        offset += blobs[i].size;
+    }
+    header.size = offset;
+
+    FILE* file = fopen(argv[1], "wb");
+    if (!file) {
+        fail("can't create", argv[1]);
+    }
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries, sizeof(PackEntry), count, file);
+    for (int i = 0; i < count; ++ i) {
+        static const Uint8 padding[PACK_ALIGN];
+        fwrite(padding, 1, entries[i].offset - ftell(file), file);
+        fwrite(blobs[i].data, 1, blobs[i].size, file);
+        free(blobs[i].data);
+    }
+    if (fclose(file) != 0) {
+        fail("can't write", argv[1]);
+    }
+    free(entries);
+    free(blobs);
+    return 0;
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+// Generates the constant tables of the game (object types, theme sprites and
+// levels) as C source, so nothing of it is built at startup:
+//
+//   gentables levels.txt > tables.c
+
+#include "types.h"
+#include "leveldata.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    ObjectTypeId typeId;
+    const char* name;
+    const char* generalName;
+    const char* solid;
+    int spriteRow;
+    int spriteColumn;
+    int spriteWidth;
+    int spriteHeight;
+    SDL_Rect body;
+    int speed;
+    const char* onInit;
+    const char* onFrame;
+    const char* onHit;
+} TypeRow;
+
+typedef struct
+{
+    ThemeId themeId;
+    ObjectTypeId typeId;
+    int spriteRow;
+    int spriteColumn;
+} ThemeRow;
+
+#define BODY(x, y, w, h) {x, y, w, h}
+#define TYPE_EX(typeId, generalTypeId, solid, spriteRow, spriteColumn, spriteWidth, spriteHeight, body, speed, onInit, onFrame, onHit) \
+    {typeId, #typeId, #generalTypeId, #solid, spriteRow, spriteColumn, spriteWidth, spriteHeight, body, speed, #onInit, #onFrame, #onHit},
+#define TYPE(typeId, generalTypeId, solid, spriteRow, spriteColumn) \
+    TYPE_EX(typeId, generalTypeId, solid, spriteRow, spriteColumn, SPRITE_SIZE, SPRITE_SIZE, \
+            BODY(0, 0, SPRITE_SIZE, SPRITE_SIZE), 0, Object_onInit, Object_onFrame, Object_onHit)
+#define THEME_SPRITE(themeId, typeId, spriteRow, spriteColumn) \
+    {themeId, typeId, spriteRow, spriteColumn},
+
+static const TypeRow typeRows[] = {
+#include "types.def"
+};
+
+static const ThemeRow themeRows[] = {
+#include "themes.def"
+};
+
+enum
+{
+    TYPE_ROW_COUNT = sizeof(typeRows) / sizeof(typeRows[0]),
+    THEME_ROW_COUNT = sizeof(themeRows) / sizeof(themeRows[0])
+};
+
+static const char* themeNames[THEME_COUNT] = {"THEME_CASTLE", "THEME_FOREST", "THEME_UNDERGROUND"};
+
+
+static void fail( const char* message )
+{
+    fprintf(stderr, "gentables: %s\n", message);
+    exit(1);
+}
+
+static char* readFile( const char* path )
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        fail("can't open the levels file");
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = (char*)malloc(size + 1);
+    text[fread(text, 1, size, file)] = 0;
+    fclose(file);
+    return text;
+}
+
+static void printRect( SDL_Rect rect )
+{
+    printf("{%d, %d, %d, %d}", rect.x, rect.y, rect.w, rect.h);
+}
+
+static void printTypes( SDL_Rect sprites[TYPE_COUNT] )
+{
+    printf("const ObjectType objectTypes[TYPE_COUNT] = {\n");
+    for (int i = 0; i < TYPE_ROW_COUNT; ++ i) {
+        const TypeRow* row = &typeRows[i];
+        printf("    [%s] = {%s, %s, ", row->name, row->name, row->generalName);
+        printRect(sprites[row->typeId]);
+        printf(", ");
+        printRect(row->body);
+        printf(", %s, FIXED(%d), %s, %s, %s},\n", row->solid, row->speed, row->onInit, row->onFrame, row->onHit);
+    }
+    printf("};\n\n");
+}
+
+static void printThemes( SDL_Rect sprites[TYPE_COUNT] )
+{
+    printf("const SDL_Rect themeSprites[THEME_COUNT][TYPE_COUNT] = {\n");
+    for (int t = 0; t < THEME_COUNT; ++ t) {
+        SDL_Rect themeSprites[TYPE_COUNT];
+        memcpy(themeSprites, sprites, sizeof(themeSprites));
+        for (int i = 0; i < THEME_ROW_COUNT; ++ i) {
+            const ThemeRow* row = &themeRows[i];
+            if (row->themeId == (ThemeId)t) {
+                themeSprites[row->typeId].y = row->spriteRow * SPRITE_SIZE;
+                themeSprites[row->typeId].x = row->spriteColumn * SPRITE_SIZE;
+            }
+        }
+        printf("    [%s] = {\n", themeNames[t]);
+        for (int i = 0; i < TYPE_ROW_COUNT; ++ i) {
+            printf("        [%s] = ", typeRows[i].name);
+            printRect(themeSprites[typeRows[i].typeId]);
+            printf(",\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n\n");
+}
+
+// The cells and objects of each level are separate arrays, because the
+// levels can have different sizes
+static void printLevel( const LevelData* level, int lr, int lc )
+{
+    printf("static const Uint8 levelCells_%d_%d[] = {\n", lr, lc);
+    for (int r = 0; r < level->rows; ++ r) {
+        printf("    ");
+        for (int c = 0; c < level->columns; ++ c) {
+            printf(c ? ", %d" : "%d", level->cells[r * level->columns + c]);
+        }
+        printf(",\n");
+    }
+    printf("};\n\n");
+
+    if (level->objectCount > 0) {
+        printf("static const LevelObject levelObjects_%d_%d[] = {\n", lr, lc);
+        for (int i = 0; i < level->objectCount; ++ i) {
+            const LevelObject* object = &level->objects[i];
+            printf("    {%d, %d, %d, %d},\n", object->typeId, object->data, object->r, object->c);
+        }
+        printf("};\n\n");
+    }
+}
+
+static void printWorld( const WorldData* world )
+{
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            printLevel(&world->levels[lr][lc], lr, lc);
+        }
+    }
+
+    printf("const WorldData worldData = {\n");
+    printf("    .levels = {\n");
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        printf("        {\n");
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            const LevelData* level = &world->levels[lr][lc];
+            printf("            {\n");
+            printf("                .rows = %d,\n", level->rows);
+            printf("                .columns = %d,\n", level->columns);
+            printf("                .cells = levelCells_%d_%d,\n", lr, lc);
+            if (level->objectCount > 0) {
+                printf("                .objects = levelObjects_%d_%d,\n", lr, lc);
+            } else {
+                printf("                .objects = NULL,\n");
+            }
+            printf("                .objectCount = %d,\n", level->objectCount);
+            printf("                .hash = %uu\n", level->hash);
+            printf("            },\n");
+        }
+        printf("        },\n");
+    }
+    printf("    },\n");
+    printf("    .startLevelR = %d,\n", world->startLevelR);
+    printf("    .startLevelC = %d,\n", world->startLevelC);
+    printf("    .startR = %d,\n", world->startR);
+    printf("    .startC = %d\n", world->startC);
+    printf("};\n");
+}
+
+int main( int argc, char* argv[] )
+{
+    if (argc != 2) {
+        fail("usage: gentables <levels file>");
+    }
+
+    static WorldData world;
+    char* text = readFile(argv[1]);
+    if (!parseWorld(text, NULL, &world)) {
+        fail("the levels file does not match the levels count or sizes");
+    }
+    free(text);
+
+    SDL_Rect sprites[TYPE_COUNT] = {{0}};
+    for (int i = 0; i < TYPE_ROW_COUNT; ++ i) {
+        const TypeRow* row = &typeRows[i];
+        sprites[row->typeId] = (SDL_Rect){row->spriteColumn * SPRITE_SIZE, row->spriteRow * SPRITE_SIZE,
+                                          row->spriteWidth, row->spriteHeight};
+    }
+
+    printf("// Generated by tools/gentables.c from types.def, themes.def and %s, do not edit\n\n", argv[1]);
+    printf("#include \"types.h\"\n");
+    printf("#include \"objects.h\"\n");
+    printf("#include \"leveldata.h\"\n\n");
+    printTypes(sprites);
+    printThemes(sprites);
+    printWorld(&world);
+    freeWorld(&world);
+    return 0;
+}
@@ -0,0 +1,231 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+// Generates a random world in the levels file format (see leveldata.h) for
+// the stress tests, e.g. with many enemies on each screen:
+//
+//   genworld --seed 7 --screens 8 --enemies b:4,g:2,`:3 --enemy-density 0.8 > stress.txt
+//   sdl_platformer --levels stress.txt --autopilot --trace stress.json
+//
+// Each level is one screen high and the given count of screens wide (up to
+// MAX_SCREENS, the widest level whose positions fit Fixed), with a floor, a
+// ceiling and random platforms. The enemies and items fill the given part of
+// the free cells, the enemy chars are picked by weight. The drops
+// (`) hang from the solid cells and the walking enemies stand on them, where
+// such a place is not found a bat is placed instead. The same seed gives the
+// same world.
+
+#include "leveldata.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    MAX_ENEMY_KINDS = 16,
+    MAX_SCREENS = LEVEL_MAX_SIZE / COLUMN_COUNT,
+    PLATFORM_SPACING = 3    // Rows between the platform rows
+};
+
+typedef struct
+{
+    Uint64 seed;
+    int screens;            // Per level, horizontally
+    double platformDensity; // Part of the platform rows covered
+    char enemies[MAX_ENEMY_KINDS];
+    int enemyWeights[MAX_ENEMY_KINDS];
+    int enemyKinds;
+    double enemyDensity;    // Part of the free cells
+    double itemDensity;
+} Options;
+
+static const char ITEMS[] = "ooooOhai";
+static const char WALKING_ENEMIES[] = "gsprqe";
+
+static Uint64 state;
+
+
+static void fail( const char* message )
+{
+    fprintf(stderr, "genworld: %s\n", message);
+    exit(1);
+}
+
+// 64-bit LCG, the high bits are used
+static Uint32 nextRandom()
+{
+    state = state * 6364136223846793005ull + 1442695040888963407ull;
+    return (Uint32)(state >> 33);
+}
+
+static double nextUniform()
+{
+    return nextRandom() / (double)(1u << 31);
+}
+
+// "b:4,g:2" as chars with weights
+static void parseEnemies( const char* text, Options* options )
+{
+    options->enemyKinds = 0;
+    while (*text) {
+        if (options->enemyKinds == MAX_ENEMY_KINDS || text[1] != ':') {
+            fail("the enemies must be like b:4,g:2,`:3");
+        }
+        char* end;
+        options->enemies[options->enemyKinds] = text[0];
+        options->enemyWeights[options->enemyKinds ++] = strtol(text + 2, &end, 10);
+        text = *end == ',' ? end + 1 : end;
+    }
+}
+
+static void parseOptions( int argc, char* argv[], Options* options )
+{
+    options->seed = 1;
+    options->screens = 1;
+    options->platformDensity = 0.5;
+    options->enemyDensity = 0.1;
+    options->itemDensity = 0.05;
+    parseEnemies("b:1,g:1,`:1,s:1,p:1", options);
+    for (int i = 1; i < argc; ++ i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            fail("usage: genworld [--seed N] [--screens N] [--platforms 0-1] [--enemies b:4,g:2,...] "
+                 "[--enemy-density 0-1] [--items 0-1]");
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options->seed = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--screens") == 0) {
+            options->screens = atoi(value);
+        } else if (strcmp(argv[i], "--platforms") == 0) {
+            options->platformDensity = atof(value);
+        } else if (strcmp(argv[i], "--enemies") == 0) {
+            parseEnemies(value, options);
+        } else if (strcmp(argv[i], "--enemy-density") == 0) {
+            options->enemyDensity = atof(value);
+        } else if (strcmp(argv[i], "--items") == 0) {
+            options->itemDensity = atof(value);
+        } else {
+            fail("unknown option");
+        }
+        ++ i;
+    }
+    // LEVEL_MAX_SIZE keeps the positions within Fixed
+    if (options->screens < 1 || options->screens > MAX_SCREENS) {
+        fprintf(stderr, "genworld: the screens count must be 1-%d\n", MAX_SCREENS);
+        exit(1);
+    }
+}
+
+static int isSolid( char s )
+{
+    return s == '*';
+}
+
+static char pickEnemy( const Options* options, const char* cells, int columns, int r, int c )
+{
+    int total = 0;
+    for (int i = 0; i < options->enemyKinds; ++ i) {
+        total += options->enemyWeights[i];
+    }
+    if (total <= 0) {
+        return 'b';
+    }
+    int k = nextRandom() % total, i = 0;
+    while (k >= options->enemyWeights[i]) {
+        k -= options->enemyWeights[i ++];
+    }
+    const char enemy = options->enemies[i];
+    if (enemy == '`' && !isSolid(cells[(r - 1) * columns + c])) {
+        return 'b';
+    }
+    if (strchr(WALKING_ENEMIES, enemy) && !isSolid(cells[(r + 1) * columns + c])) {
+        return 'b';
+    }
+    return enemy;
+}
+
+// The cells of the level, row by row
+static void generateLevel( const Options* options, char* cells, int rows, int columns, int start )
+{
+    memset(cells, ' ', rows * columns);
+    for (int c = 0; c < columns; ++ c) {
+        cells[c] = '*';
+        cells[(rows - 1) * columns + c] = '*';
+    }
+
+    // Platforms of 2-7 cells, with gaps, so the rows are not closed
+    for (int r = PLATFORM_SPACING + 1; r < rows - 2; r += PLATFORM_SPACING) {
+        for (int c = 0; c < columns;) {
+            const int length = 2 + nextRandom() % 6;
+            if (nextUniform() < options->platformDensity) {
+                for (int i = c; i < c + length && i < columns; ++ i) {
+                    cells[r * columns + i] = '*';
+                }
+            }
+            c += length + 1 + nextRandom() % 3;
+        }
+    }
+
+    if (start) {
+        cells[(rows - 2) * columns + 1] = 'P';
+    }
+
+    for (int r = 1; r < rows - 1; ++ r) {
+        for (int c = 0; c < columns; ++ c) {
+            char* cell = &cells[r * columns + c];
+            if (*cell != ' ' || (start && r == rows - 2 && c < 4)) {
+                continue;
+            }
+            const double x = nextUniform();
+            if (x < options->enemyDensity) {
+                *cell = pickEnemy(options, cells, columns, r, c);
+            } else if (x < options->enemyDensity + options->itemDensity) {
+                *cell = ITEMS[nextRandom() % (sizeof(ITEMS) - 1)];
+            }
+        }
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    Options options;
+    parseOptions(argc, argv, &options);
+    state = options.seed;
+
+    const int rows = ROW_COUNT;
+    const int columns = COLUMN_COUNT * options.screens;
+    char* cells[LEVEL_COUNTY][LEVEL_COUNTX];
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            cells[lr][lc] = (char*)malloc(rows * columns);
+            generateLevel(&options, cells[lr][lc], rows, columns, lr == 0 && lc == 0);
+        }
+    }
+
+    printf("columns");
+    for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+        printf(" %d", columns);
+    }
+    printf("\nrows");
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        printf(" %d", rows);
+    }
+    printf("\n");
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int r = 0; r < rows; ++ r) {
+            for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+                fwrite(&cells[lr][lc][r * columns], 1, columns, stdout);
+            }
+            printf("\n");
+        }
+    }
+
+    for (int lr = 0; lr < LEVEL_COUNTY; ++ lr) {
+        for (int lc = 0; lc < LEVEL_COUNTX; ++ lc) {
+            free(cells[lr][lc]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#include "trace.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum { TRACE_MAX_EVENTS = 1 << 20 }; // The later events are dropped
+
+#define TYPE(typeId, ...) [typeId] = #typeId,
+#define TYPE_EX(typeId, ...) [typeId] = #typeId,
+static const char* const TYPE_NAMES[TYPE_COUNT] = {
+#include "types.def"
+};
+#undef TYPE
+#undef TYPE_EX
+
+#define TYPE(typeId, ...) [typeId] = {"Object_onInit", "Object_onFrame", "Object_onHit"},
+#define TYPE_EX(typeId, generalTypeId, solid, spriteRow, spriteColumn, spriteWidth, spriteHeight, body, speed, onInit, onFrame, onHit) \
+    [typeId] = {#onInit, #onFrame, #onHit},
+static const char* const HANDLER_NAMES[TYPE_COUNT][TRACE_HANDLER_COUNT] = {
+#include "types.def"
+};
+#undef TYPE
+#undef TYPE_EX
+
+typedef struct
+{
+    const char* phase;      // NULL for the handlers
+    Sint16 handler;
+    Sint16 typeId;
+    Uint32 thread;
+    Uint64 start;           // Performance counter
+    Uint64 end;
+} TraceEvent;
+
+int traceEnabled = 0;
+
+static struct
+{
+    char* path;
+    TraceEvent* events;
+    int count;              // Added events, the ones over TRACE_MAX_EVENTS are dropped
+    Uint32 threadCount;
+    Uint64 start;
+} trace;
+
+static __thread Uint32 traceThread = 0; // Assigned at the first event of the thread
+
+
+void startTrace( const char* path )
+{
+    if (trace.events) {
+        return;
+    }
+    trace.path = strdup(path);
+    trace.events = (TraceEvent*)allocMemory(MEMORY_TRACE, sizeof(TraceEvent) * TRACE_MAX_EVENTS);
+    trace.count = 0;
+    trace.threadCount = 0;
+    trace.start = SDL_GetPerformanceCounter();
+    __atomic_store_n(&traceEnabled, 1, __ATOMIC_RELAXED);
+    atexit(stopTrace);
+}
+
+// Safe to call from many threads, the slots are taken atomically
+void addTraceEvent( const char* phase, int handler, int typeId, Uint64 start )
+{
+    const Uint64 end = SDL_GetPerformanceCounter();
+    const int i = __atomic_fetch_add(&trace.count, 1, __ATOMIC_RELAXED);
+    if (i >= TRACE_MAX_EVENTS) {
+        __atomic_store_n(&traceEnabled, 0, __ATOMIC_RELAXED);
+        return;
+    }
+    if (!traceThread) {
+        traceThread = __atomic_add_fetch(&trace.threadCount, 1, __ATOMIC_RELAXED);
+    }
+    TraceEvent* event = &trace.events[i];
+    event->phase = phase;
+    event->handler = handler;
+    event->typeId = typeId;
+    event->thread = traceThread;
+    event->start = start;
+    event->end = end;
+}
+
+static void writeEvents( FILE* file, int count, double ticksPerUs )
+{
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (int i = 0; i < count; ++ i) {
+        const TraceEvent* event = &trace.events[i];
+        const double ts = (event->start - trace.start) / ticksPerUs;
+        const double dur = (event->end - event->start) / ticksPerUs;
+        fprintf(file, "%s{\"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f, ",
+                i ? ",\n" : "", event->thread, ts, dur);
+        if (event->phase) {
+            fprintf(file, "\"cat\": \"frame\", \"name\": \"%s\"}", event->phase);
+        } else {
+            fprintf(file, "\"cat\": \"object\", \"name\": \"%s %s\", \"args\": {\"type\": \"%s\"}}",
+                    HANDLER_NAMES[event->typeId][event->handler], TYPE_NAMES[event->typeId], TYPE_NAMES[event->typeId]);
+        }
+    }
+    fprintf(file, "\n]}\n");
+}
+
+// Total time of each handler and type, the most expensive first
+static void printHandlerTotals( int count, int added, double ticksPerUs )
+{
+    static Uint64 totals[TYPE_COUNT * TRACE_HANDLER_COUNT];
+    static int calls[TYPE_COUNT * TRACE_HANDLER_COUNT];
+    memset(totals, 0, sizeof(totals));
+    memset(calls, 0, sizeof(calls));
+    for (int i = 0; i < count; ++ i) {
+        const TraceEvent* event = &trace.events[i];
+        if (!event->phase) {
+            const int k = event->typeId * TRACE_HANDLER_COUNT + event->handler;
+            totals[k] += event->end - event->start;
+            calls[k] += 1;
+        }
+    }
+
+    printf("trace: %d events written to %s", count, trace.path);
+    printf(added > count ? ", %d dropped\n" : "\n", added - count);
+    for (;;) {
+        int top = -1;
+        for (int k = 0; k < TYPE_COUNT * TRACE_HANDLER_COUNT; ++ k) {
+            if (calls[k] && (top == -1 || totals[k] > totals[top])) {
+                top = k;
+            }
+        }
+        if (top == -1) {
+            break;
+        }
+        printf("  %-28s %-20s %10.3f ms, %8d calls\n", HANDLER_NAMES[top / TRACE_HANDLER_COUNT][top % TRACE_HANDLER_COUNT],
+               TYPE_NAMES[top / TRACE_HANDLER_COUNT], totals[top] / ticksPerUs / 1000, calls[top]);
+        calls[top] = 0;
+    }
+}
+
+// Writes the trace, the other threads must not add events anymore
+void stopTrace()
+{
+    if (!trace.events) {
+        return;
+    }
+    __atomic_store_n(&traceEnabled, 0, __ATOMIC_RELAXED);
+    // The scopes begun before are dropped
+    const int added = __atomic_exchange_n(&trace.count, TRACE_MAX_EVENTS, __ATOMIC_RELAXED);
+    const int count = SDL_min(added, TRACE_MAX_EVENTS);
+    const double ticksPerUs = SDL_GetPerformanceFrequency() / 1000000.0;
+    FILE* file = fopen(trace.path, "w");
+    if (file) {
+        writeEvents(file, count, ticksPerUs);
+        fclose(file);
+        printHandlerTotals(count, added, ticksPerUs);
+    } else {
+        printf("trace: can't write %s\n", trace.path);
+    }
+    freeMemory(MEMORY_TRACE, trace.events, sizeof(TraceEvent) * TRACE_MAX_EVENTS);
+    free(trace.path);
+    trace.events = NULL;
+    trace.path = NULL;
+}
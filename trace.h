@@ -0,0 +1,56 @@
+/******************************************************************************
+ * Copyright (c) Artur Eganyan
+ *
+ * This software is provided "AS IS", WITHOUT ANY WARRANTY, express or implied.
+ ******************************************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "types.h"
+
+// Tracing of the frame phases and of the object handlers by type, written on
+// exit as a trace event JSON file for chrome://tracing or Perfetto, with the
+// total time per handler and type printed. A traced scope is
+//
+//   const Uint64 start = beginTrace();
+//   ...
+//   endPhaseTrace("draw", start);
+//
+// When tracing is off, beginTrace() returns 0 and the end does nothing, so a
+// scope costs a load and two branches.
+
+typedef enum
+{
+    TRACE_ON_INIT = 0,
+    TRACE_ON_FRAME,
+    TRACE_ON_HIT,
+    TRACE_HANDLER_COUNT
+} TraceHandler;
+
+extern int traceEnabled; // Read and written by many threads, only atomically
+
+void startTrace( const char* path ); // The trace is written on exit
+void stopTrace();
+void addTraceEvent( const char* phase, int handler, int typeId, Uint64 start );
+
+static inline Uint64 beginTrace()
+{
+    return __atomic_load_n(&traceEnabled, __ATOMIC_RELAXED) ? SDL_GetPerformanceCounter() : 0;
+}
+
+static inline void endPhaseTrace( const char* phase, Uint64 start )
+{
+    if (start) {
+        addTraceEvent(phase, -1, -1, start);
+    }
+}
+
+static inline void endHandlerTrace( TraceHandler handler, ObjectTypeId typeId, Uint64 start )
+{
+    if (start) {
+        addTraceEvent(NULL, handler, typeId, start);
+    }
+}
+
+#endif
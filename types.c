@@ -6,13 +6,16 @@
 
 #include "types.h"
 #include "render.h"
-#include "objects.h"
+#include "game.h"
+#include "timerwheel.h"
+#include "memory.h"
+#include "navigation.h"
+#include "trace.h"
+#include <string.h>
+#include <stddef.h>
 
 enum { MIN_FRAME_RATE = 24 };
 const double MAX_DELTA_TIME = 1000.0 / MIN_FRAME_RATE;
-const double MAX_SPEED = MIN_FRAME_RATE * CELL_SIZE;
-
-ObjectType objectTypes[TYPE_COUNT];
 
 
 // ObjectArray
@@ -21,71 +24,195 @@ void ObjectArray_init( ObjectArray* objects )
 {
     objects->reserved = 16;
     objects->count = 0;
-    objects->array = (Object**)malloc(sizeof(Object*) * objects->reserved);
+    objects->array = (Object**)allocMemory(MEMORY_OBJECT_ARRAYS, sizeof(Object*) * objects->reserved);
 }
 
 void ObjectArray_append( ObjectArray* objects, Object* object )
 {
     if (objects->count == objects->reserved) {
-        objects->reserved *= 2;
-        objects->array = (Object**)realloc(objects->array, sizeof(Object*) * objects->reserved);
+        const int reserved = objects->reserved ? objects->reserved * 2 : 16;
+        objects->array = (Object**)reallocMemory(MEMORY_OBJECT_ARRAYS, objects->array,
+                                                 sizeof(Object*) * objects->reserved, sizeof(Object*) * reserved);
+        objects->reserved = reserved;
     }
     objects->array[objects->count ++] = object;
 }
 
+// Moves the last object to the position i, so the order is not preserved
+void ObjectArray_removeAt( ObjectArray* objects, int i )
+{
+    objects->array[i] = objects->array[-- objects->count];
+}
+
 void ObjectArray_free( ObjectArray* objects )
 {
-    free(objects->array);
+    freeMemory(MEMORY_OBJECT_ARRAYS, objects->array, sizeof(Object*) * objects->reserved);
     objects->array = NULL;
     objects->reserved = 0;
     objects->count = 0;
 }
 
-void ObjectArray_clean( ObjectArray* objects )
+
+
+// ObjectLayers
+
+// The buckets allocate memory on the first insertion, because most types have
+// no objects on a level
+void ObjectLayers_init( ObjectLayers* layers )
+{
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        ObjectArray* bucket = &layers->buckets[t];
+        bucket->array = NULL;
+        bucket->reserved = 0;
+        bucket->count = 0;
+        layers->awake[t] = 0;
+    }
+    layers->count = 0;
+}
+
+static void swapObjects( ObjectArray* objects, int i, int j )
+{
+    Object* object = objects->array[i];
+    objects->array[i] = objects->array[j];
+    objects->array[j] = object;
+}
+
+// The object is inserted awake
+void ObjectLayers_insert( ObjectLayers* layers, Object* object )
+{
+    const ObjectTypeId typeId = object->type->typeId;
+    ObjectArray* bucket = &layers->buckets[typeId];
+    ObjectArray_append(bucket, object);
+    swapObjects(bucket, layers->awake[typeId] ++, bucket->count - 1);
+    layers->count += 1;
+}
+
+// If the object is awake, the last awake object is moved to the position i
+void ObjectLayers_removeAt( ObjectLayers* layers, ObjectTypeId typeId, int i )
+{
+    ObjectArray* bucket = &layers->buckets[typeId];
+    if (i < layers->awake[typeId]) {
+        const int last = -- layers->awake[typeId];
+        bucket->array[i] = bucket->array[last];
+        i = last;
+    }
+    ObjectArray_removeAt(bucket, i);
+    layers->count -= 1;
+}
+
+// Moves the awake object at the position i to the sleeping ones, putting the
+// last awake object in its place
+void ObjectLayers_sleepAt( ObjectLayers* layers, ObjectTypeId typeId, int i )
 {
-    int r = 0;
-    for (int i = 0; i < objects->count; ++ i) {
-        Object* object = objects->array[i];
-        if (object->removed == 1) {
-            free(object);
-            r += 1;
-        } else if (object->removed == 2) {
-            r += 1;
-        } else if (r) {
-            objects->array[i - r] = object;
+    swapObjects(&layers->buckets[typeId], i, -- layers->awake[typeId]);
+}
+
+void ObjectLayers_wake( ObjectLayers* layers, Object* object )
+{
+    const ObjectTypeId typeId = object->type->typeId;
+    ObjectArray* bucket = &layers->buckets[typeId];
+    for (int i = layers->awake[typeId]; i < bucket->count; ++ i) {
+        if (bucket->array[i] == object) {
+            swapObjects(bucket, i, layers->awake[typeId] ++);
+            return;
         }
     }
-    objects->count -= r;
 }
 
-static int compareByDepth( const void* object1, const void* object2 )
+void ObjectLayers_free( ObjectLayers* layers )
+{
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        ObjectArray_free(&layers->buckets[t]);
+        layers->awake[t] = 0;
+    }
+    layers->count = 0;
+}
+
+
+// Level chunks
+
+// Shared by all the empty chunks of all levels, must not be changed
+static const Chunk emptyChunk = {
+    .cells = {[0 ... CHUNK_MASK] = {[0 ... CHUNK_MASK] = &objectTypes[TYPE_NONE]}}
+};
+
+int isChunkAllocated( const Chunk* chunk )
 {
-    return ((const Object*)object2)->type->typeId - ((const Object*)object1)->type->typeId;
+    return chunk != &emptyChunk;
 }
 
-void ObjectArray_sortByDepth( ObjectArray* objects )
+// Returns the chunk of the cell, allocating it if it's the empty one
+Chunk* getWritableChunk( Level* level, int r, int c )
 {
-    qsort(objects->array, objects->count, sizeof(Object*), compareByDepth);
+    Chunk** chunk = &level->chunks[(r >> CHUNK_SHIFT) * level->chunkColumns + (c >> CHUNK_SHIFT)];
+    if (!isChunkAllocated(*chunk)) {
+        *chunk = (Chunk*)allocMemory(MEMORY_LEVELS, sizeof(Chunk));
+        memcpy(*chunk, &emptyChunk, sizeof(Chunk));
+    }
+    return *chunk;
 }
 
 
 // Object constructors
 
+// Replaces the cell and updates the walls counts in its row
 void createStaticObject( Level* level, ObjectTypeId typeId, int r, int c )
 {
-    level->cells[r][c] = &objectTypes[typeId];
+    static const int WALL = SOLID_LEFT | SOLID_RIGHT;
+    if (getCell(level, r, c) == &objectTypes[typeId]) {
+        return;
+    }
+    Chunk* chunk = getWritableChunk(level, r, c);
+    const ObjectType** cell = &chunk->cells[r & CHUNK_MASK][c & CHUNK_MASK];
+    const int wasWall = ((*cell)->solid & WALL) == WALL;
+    *cell = &objectTypes[typeId];
+    const int delta = (((*cell)->solid & WALL) == WALL) - wasWall;
+    if (delta) {
+        for (int i = (c & CHUNK_MASK) + 1; i <= CHUNK_SIZE; ++ i) {
+            chunk->walls[r & CHUNK_MASK][i] += delta;
+        }
+        for (int i = (c >> CHUNK_SHIFT) + 1; i < level->chunkColumns; ++ i) {
+            level->walls[r * level->chunkColumns + i] += delta;
+        }
+    }
+    level->navigation.valid = 0;
+    level->revision += 1;
+}
+
+// Allocates an object of the type, without initialization
+Object* allocObject( ObjectTypeId typeId )
+{
+    trackObjects(typeId, 1);
+    return (Object*)allocMemory(MEMORY_OBJECTS, sizeof(Object));
+}
+
+// The object type must be the same as at the allocation
+void freeObject( Object* object )
+{
+    trackObjects(object->type->typeId, -1);
+    freeMemory(MEMORY_OBJECTS, object, sizeof(Object));
 }
 
 Object* createObject( Level* level, ObjectTypeId typeId, int r, int c )
 {
-    Object* object = (Object*)malloc(sizeof(Object));
+    Object* object = allocObject(typeId);
     initObject(object, typeId);
-    object->x = CELL_SIZE * c;
-    object->y = CELL_SIZE * r;
-    ObjectArray_append(&level->objects, object);
+    object->x = intToFixed(CELL_SIZE * c);
+    object->y = intToFixed(CELL_SIZE * r);
+    ObjectLayers_insert(&level->objects, object);
+    updateObjectChunk(level, object);
     return object;
 }
 
+// Frees the removed object, unless it's marked as removed without freeing
+// (removed == 2). The caller must exclude the object from its array.
+void releaseObject( Object* object )
+{
+    if (object->removed == 1) {
+        freeObject(object);
+    }
+}
+
 void initObject( Object* object, ObjectTypeId typeId )
 {
     object->type = &objectTypes[typeId];
@@ -96,14 +223,30 @@ void initObject( Object* object, ObjectTypeId typeId )
     object->removed = 0;
     object->state = 0;
     object->data = 0;
+    object->id = newObjectId();
+    object->randomCount = 0;
+    object->sleeping = 0;
+    object->sleepTime = 0;
+    object->wakeTime = 0;
+    object->nextSleeper = NULL;
+    object->nextTimer = NULL;
+    object->timerLink = NULL;
+    object->nextInChunk = NULL;
+    object->chunkLink = NULL;
+    object->chunk = 0;
     object->anim.flip = SDL_FLIP_NONE;
     object->anim.frameDelayCounter = 0;
     object->anim.type = ANIMATION_FRAME;
     object->anim.alpha = 255;
     setAnimation(object, 0, 0, 0);
+    const Uint64 traceStart = beginTrace();
     object->type->onInit(object);
+    endHandlerTrace(TRACE_ON_INIT, typeId, traceStart);
 }
 
+// The last field of Object, the player is used as an object everywhere
+_Static_assert(offsetof(Player, chunk) == offsetof(Object, chunk), "Player must begin with the fields of Object");
+
 void initPlayer( Player* player )
 {
     initObject((Object*)player, TYPE_PLAYER);
@@ -117,103 +260,110 @@ void initPlayer( Player* player )
     ObjectArray_init(&player->items);
 }
 
-void initLevel( Level* level )
+void initLevel( Level* level, int rows, int columns )
 {
-    for (int r = 0; r < ROW_COUNT; ++ r) {
-        for (int c = 0; c < COLUMN_COUNT; ++ c) {
-            level->cells[r][c] = &objectTypes[TYPE_NONE];
-        }
+    level->rows = rows;
+    level->columns = columns;
+    level->chunkRows = (rows + CHUNK_MASK) >> CHUNK_SHIFT;
+    level->chunkColumns = (columns + CHUNK_MASK) >> CHUNK_SHIFT;
+    const int chunkCount = level->chunkRows * level->chunkColumns;
+    level->chunks = (Chunk**)allocMemory(MEMORY_LEVELS, sizeof(Chunk*) * chunkCount);
+    for (int i = 0; i < chunkCount; ++ i) {
+        level->chunks[i] = (Chunk*)&emptyChunk;
     }
-    level->init = 0;
+    level->chunkObjects = (Object**)allocMemory(MEMORY_LEVELS, sizeof(Object*) * chunkCount);
+    memset(level->chunkObjects, 0, sizeof(Object*) * chunkCount);
+    level->walls = (int*)allocMemory(MEMORY_LEVELS, sizeof(int) * rows * level->chunkColumns);
+    memset(level->walls, 0, sizeof(int) * rows * level->chunkColumns);
+    memset(&level->navigation, 0, sizeof(level->navigation));
+    TimerWheel_init(&level->timers, 0);
+    level->waking.array = NULL;
+    level->waking.reserved = 0;
+    level->waking.count = 0;
+    level->time = 0;
+    level->revision = 0;
+    level->theme = THEME_UNDERGROUND;
     level->r = 0;
     level->c = 0;
-    ObjectArray_init(&level->objects);
-}
-
-
-// Types
-
-static void initTypeEx( ObjectTypeId typeId, ObjectTypeId generalTypeId, int solid,
-                        int spriteRow, int spriteColumn, int spriteWidth, int spriteHeight,
-                        SDL_Rect body, double speed, OnInit onInit, OnFrame onFrame, OnHit onHit )
-{
-    ObjectType* type = &objectTypes[typeId];
-    type->typeId = typeId;
-    type->generalTypeId = generalTypeId;
-    type->sprite.y = spriteRow * SPRITE_SIZE;
-    type->sprite.x = spriteColumn * SPRITE_SIZE;
-    type->sprite.w = spriteWidth;
-    type->sprite.h = spriteHeight;
-    type->body = body;
-    type->solid = solid;
-    type->speed = speed;
-    type->onInit = onInit;
-    type->onFrame = onFrame;
-    type->onHit = onHit;
-}
-
-static void initType( ObjectTypeId typeId, ObjectTypeId generalTypeId, int solid, int spriteRow, int spriteColumn )
-{
-    initTypeEx(typeId, generalTypeId, solid, spriteRow, spriteColumn, SPRITE_SIZE, SPRITE_SIZE,
-               (SDL_Rect){0, 0, 16, 16}, 0, Object_onInit, Object_onFrame, Object_onHit);
-}
-
-void initTypes()
-{
-    //             type id            general type id         solid     sprite r, c, w, h              body             speed          onInit                 onFrame                     onHit
-    initType    ( TYPE_NONE,            TYPE_NONE,              0,        0,  10                                                                                                                              );
-    initTypeEx  ( TYPE_PLAYER,          TYPE_PLAYER,            0,        1,  26, 16, 16,  (SDL_Rect){6,  0,  4,  16},    0,       Object_onInit,          Object_onFrame,             Object_onHit           );
-    initType    ( TYPE_WALL_TOP,        TYPE_WALL,          SOLID_ALL,    4,  6                                                                                                                               );
-    initType    ( TYPE_WALL,            TYPE_WALL,          SOLID_ALL,    5,  6                                                                                                                               );
-    initType    ( TYPE_WALL_FAKE,       TYPE_WALL_FAKE,         0,        5,  6                                                                                                                               );
-    initTypeEx  ( TYPE_WALL_STAIR,      TYPE_WALL,          SOLID_TOP,    4,  6,  16, 8,   (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Object_onFrame,             Object_onHit           );
-    initType    ( TYPE_GROUND_TOP,      TYPE_WALL,          SOLID_ALL,    6,  3                                                                                                                               );
-    initType    ( TYPE_GROUND,          TYPE_WALL,          SOLID_ALL,    7,  3                                                                                                                               );
-    initType    ( TYPE_GROUND_FAKE,     TYPE_GROUND_FAKE,       0,        7,  3                                                                                                                               );
-    initTypeEx  ( TYPE_GROUND_STAIR,    TYPE_WALL,          SOLID_ALL,    6,  3,  16, 8,   (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Object_onFrame,             Object_onHit           );
-    initTypeEx  ( TYPE_WATER_TOP,       TYPE_WATER,             0,        8,  0,  16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Water_onInit,           Object_onFrame,             Water_onHit            );
-    initType    ( TYPE_WATER,           TYPE_WATER,             0,        9,  0                                                                                                                               );
-    initType    ( TYPE_GRASS,           TYPE_BACKGROUND,        0,        40, 0                                                                                                                               );
-    initType    ( TYPE_GRASS_BIG,       TYPE_BACKGROUND,        0,        40, 0                                                                                                                               );
-    initType    ( TYPE_ROCK,            TYPE_BACKGROUND,    SOLID_ALL,    50, 0                                                                                                                               );
-    initType    ( TYPE_SPIKE_TOP,       TYPE_SPIKE,             0,        48, 0                                                                                                                               );
-    initType    ( TYPE_SPIKE_BOTTOM,    TYPE_SPIKE,             0,        49, 0                                                                                                                               );
-    initType    ( TYPE_TREE1,           TYPE_BACKGROUND,        0,        41, 3                                                                                                                               );
-    initType    ( TYPE_TREE2,           TYPE_BACKGROUND,        0,        41, 4                                                                                                                               );
-    initTypeEx  ( TYPE_CLOUD1,          TYPE_PLATFORM,          0,        51, 6,  16, 16,  (SDL_Rect){0,  0, 16, 16},     0,       Object_onInit,          Object_onFrame,             Cloud_onHit            );
-    initType    ( TYPE_CLOUD2,          TYPE_PLATFORM,          0,        51, 5                                                                                                                               );
-    initType    ( TYPE_MUSHROOM1,       TYPE_BACKGROUND,        0,        47, 0                                                                                                                               );
-    initType    ( TYPE_MUSHROOM2,       TYPE_BACKGROUND,        0,        47, 1                                                                                                                               );
-    initType    ( TYPE_MUSHROOM3,       TYPE_BACKGROUND,        0,        47, 2                                                                                                                               );
-    initType    ( TYPE_PILLAR_TOP,      TYPE_BACKGROUND,        0,        26, 2                                                                                                                               );
-    initType    ( TYPE_PILLAR,          TYPE_BACKGROUND,        0,        27, 2                                                                                                                               );
-    initType    ( TYPE_PILLAR_BOTTOM,   TYPE_BACKGROUND,        0,        28, 2                                                                                                                               );
-    initTypeEx  ( TYPE_TORCH,           TYPE_BACKGROUND,        0,        62, 26, 16, 16,  (SDL_Rect){5,  0,  6,  6},     0,       Torch_onInit,           Object_onFrame,             Torch_onHit            );
-    initType    ( TYPE_DOOR,            TYPE_DOOR,          SOLID_ALL,    10, 0                                                                                                                               );
-    initType    ( TYPE_LADDER,          TYPE_LADDER,            0,        12, 2                                                                                                                               );
-    initTypeEx  ( TYPE_GHOST,           TYPE_ENEMY,             0,        7,  26, 16, 16,  (SDL_Rect){2,  0,  12, 16},   24,       MovingEnemy_onInit,     ShootingEnemy_onFrame,      Object_onHit           );
-    initTypeEx  ( TYPE_SCORPION,        TYPE_ENEMY,             0,        10, 26, 16, 16,  (SDL_Rect){3,  5,  10, 11},   24,       MovingEnemy_onInit,     MovingEnemy_onFrame,        MovingEnemy_onHit      );
-    initTypeEx  ( TYPE_SPIDER,          TYPE_ENEMY,             0,        11, 26, 16, 16,  (SDL_Rect){3,  6,  10, 10},   24,       MovingEnemy_onInit,     Spider_onFrame,             MovingEnemy_onHit      );
-    initTypeEx  ( TYPE_RAT,             TYPE_ENEMY,             0,        9,  26, 16, 16,  (SDL_Rect){2,  5,  12, 11},   24,       MovingEnemy_onInit,     MovingEnemy_onFrame,        MovingEnemy_onHit      );
-    initTypeEx  ( TYPE_BAT,             TYPE_ENEMY,             0,        8,  26, 16, 16,  (SDL_Rect){0,  3,  16, 10},   48,       Bat_onInit,             Bat_onFrame,                Bat_onHit              );
-    initTypeEx  ( TYPE_BLOB,            TYPE_ENEMY,             0,        61, 26, 16, 16,  (SDL_Rect){3,  6,  10, 10},   24,       MovingEnemy_onInit,     MovingEnemy_onFrame,        MovingEnemy_onHit      );
-    initTypeEx  ( TYPE_FIREBALL,        TYPE_ENEMY,             0,        13, 26, 16, 16,  (SDL_Rect){2,  3,  14, 12},   48,       Fireball_onInit,        Fireball_onFrame,           Bat_onHit              );
-    initTypeEx  ( TYPE_SKELETON,        TYPE_ENEMY,             0,        6,  26, 16, 16,  (SDL_Rect){1,  0,  14, 16},   24,       MovingEnemy_onInit,     TeleportingEnemy_onFrame,   TeleportingEnemy_onHit );
-    initTypeEx  ( TYPE_ICESHOT,         TYPE_ENEMY,             0,        52, 0,  16, 16,  (SDL_Rect){0,  4,  16, 7},   168,       Shot_onInit,            Shot_onFrame,               Shot_onHit             );
-    initTypeEx  ( TYPE_FIRESHOT,        TYPE_ENEMY,             0,        60, 26, 16, 16,  (SDL_Rect){6,  6,  4,  4},   120,       Shot_onInit,            Shot_onFrame,               Shot_onHit             );
-    initTypeEx  ( TYPE_DROP,            TYPE_DROP,              0,        37, 43, 16, 16,  (SDL_Rect){6,  6,  4,  4},     0,       Drop_onInit,            Drop_onFrame,               Drop_onHit             );
-    initTypeEx  ( TYPE_PLATFORM,        TYPE_PLATFORM,          0,        4,  6,  16, 8,   (SDL_Rect){0,  0,  16, 8},    48,       Platform_onInit,        Platform_onFrame,           Platform_onHit         );
-    initTypeEx  ( TYPE_SPRING,          TYPE_SPRING,            0,        65, 26, 16, 16,  (SDL_Rect){0,  8,  16, 8},     0,       Spring_onInit,          Spring_onFrame,             Spring_onHit           );
-    initTypeEx  ( TYPE_ARROW_LEFT,      TYPE_WALL,          SOLID_LEFT,   32, 3,  16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Object_onFrame,             Object_onHit           );
-    initTypeEx  ( TYPE_ARROW_RIGHT,     TYPE_WALL,          SOLID_RIGHT,  31, 3,  16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Object_onFrame,             Object_onHit           );
-    initTypeEx  ( TYPE_KEY,             TYPE_KEY,               0,        45, 26, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_COIN,            TYPE_COIN,              0,        63, 26, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_GEM,             TYPE_COIN,              0,        50, 32, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_APPLE,           TYPE_ITEM,              0,        15, 26, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_PEAR,            TYPE_ITEM,              0,        15, 27, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_STATUARY,        TYPE_STATUARY,          0,        52, 27, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_LADDER_PART,     TYPE_ITEM,              0,        62, 29, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_PICK,            TYPE_ITEM,              0,        62, 30, 16, 16,  (SDL_Rect){0,  0,  16, 16},    0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initTypeEx  ( TYPE_HEART,           TYPE_HEART,             0,        62, 31, 16, 16,  (SDL_Rect){4,  4,  8,  8},     0,       Object_onInit,          Item_onFrame,               Item_onHit             );
-    initType    ( TYPE_ACTION,          TYPE_ITEM,              0,        0,  10                                                                                                                              );
+    ObjectLayers_init(&level->objects);
+}
+
+// The objects are kept in the lists by the chunk of their center, clamped to
+// the level, so the visible ones are found without passing all of them. The
+// lists are doubly linked through chunkLink, so an object moves to another
+// chunk in constant time.
+static int getObjectChunk( const Level* level, const Object* object )
+{
+    const int r = SDL_min(SDL_max(fixedToInt(object->y) + CELL_HALF, 0) / CELL_SIZE, level->rows - 1);
+    const int c = SDL_min(SDL_max(fixedToInt(object->x) + CELL_HALF, 0) / CELL_SIZE, level->columns - 1);
+    return (r >> CHUNK_SHIFT) * level->chunkColumns + (c >> CHUNK_SHIFT);
+}
+
+void updateObjectChunk( Level* level, Object* object )
+{
+    const int chunk = getObjectChunk(level, object);
+    if (object->chunkLink && object->chunk == chunk) {
+        return;
+    }
+    removeObjectChunk(object);
+    Object** head = &level->chunkObjects[chunk];
+    object->nextInChunk = *head;
+    if (*head) {
+        (*head)->chunkLink = &object->nextInChunk;
+    }
+    *head = object;
+    object->chunkLink = head;
+    object->chunk = chunk;
+}
+
+void removeObjectChunk( Object* object )
+{
+    if (object->chunkLink) {
+        *object->chunkLink = object->nextInChunk;
+        if (object->nextInChunk) {
+            object->nextInChunk->chunkLink = object->chunkLink;
+        }
+        object->nextInChunk = NULL;
+        object->chunkLink = NULL;
+    }
+}
+
+// Builds the lists again, e.g. after the objects are restored
+void resetObjectChunks( Level* level )
+{
+    memset(level->chunkObjects, 0, sizeof(Object*) * level->chunkRows * level->chunkColumns);
+    for (int t = 0; t < TYPE_COUNT; ++ t) {
+        const ObjectArray* bucket = &level->objects.buckets[t];
+        for (int i = 0; i < bucket->count; ++ i) {
+            if (bucket->array[i]->type->typeId != TYPE_PLAYER) {
+                bucket->array[i]->chunkLink = NULL;
+                updateObjectChunk(level, bucket->array[i]);
+            }
+        }
+    }
 }
+
+// Frees the cells and lookups of the level, but not its objects
+void freeLevel( Level* level )
+{
+    const int chunkCount = level->chunkRows * level->chunkColumns;
+    for (int i = 0; i < chunkCount; ++ i) {
+        if (isChunkAllocated(level->chunks[i])) {
+            freeMemory(MEMORY_LEVELS, level->chunks[i], sizeof(Chunk));
+        }
+    }
+    freeMemory(MEMORY_LEVELS, level->chunks, sizeof(Chunk*) * chunkCount);
+    freeMemory(MEMORY_LEVELS, level->chunkObjects, sizeof(Object*) * chunkCount);
+    freeMemory(MEMORY_LEVELS, level->walls, sizeof(int) * level->rows * level->chunkColumns);
+    freeNavigation(level);
+    ObjectLayers_free(&level->objects);
+    ObjectArray_free(&level->waking);
+    level->chunks = NULL;
+    level->chunkObjects = NULL;
+    level->walls = NULL;
+    level->rows = 0;
+    level->columns = 0;
+    level->chunkRows = 0;
+    level->chunkColumns = 0;
+}
+
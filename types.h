@@ -11,6 +11,8 @@
 
 //#define DEBUG_MODE
 
+// The level sizes are the screen size and the default size of the levels,
+// which can be larger or smaller, see Level
 typedef enum
 {
     LEVEL_WIDTH = 320,
@@ -21,12 +23,32 @@ typedef enum
     ROW_COUNT = (LEVEL_HEIGHT + CELL_SIZE - 1) / CELL_SIZE,
     COLUMN_COUNT = (LEVEL_WIDTH + CELL_SIZE - 1) / CELL_SIZE,
     CELL_COUNT = ROW_COUNT * COLUMN_COUNT,
-    SIZE_FACTOR = 2,
+    SIZE_FACTOR = 2, // Default window scale
     FRAME_RATE = 48  // If <= 0, renders without upper fps limit
 } Constant;
 
-extern const double MAX_DELTA_TIME; // Maximum delta time at which the hit test still works, milliseconds
-extern const double MAX_SPEED;      // Maximum speed at which the hit test still works, pixels per second
+// Fixed-point number with 16 fractional bits. It's used for the positions
+// (pixels) and speeds (pixels per second), so that the game logic gives the
+// same results regardless of the compiler and platform.
+typedef Sint32 Fixed;
+
+enum
+{
+    FIXED_SHIFT = 16,
+    FIXED_ONE = 1 << FIXED_SHIFT,
+    FIXED_MAX_INT = 0x7FFFFFFF >> FIXED_SHIFT  // The largest integer part
+};
+
+#define FIXED(value) ((Fixed)((value) * FIXED_ONE)) // For constant expressions
+
+static inline Fixed intToFixed( int value )     { return value * FIXED_ONE; }
+static inline int fixedToInt( Fixed value )     { return value >> FIXED_SHIFT; } // Rounds down
+static inline double fixedToDouble( Fixed value ) { return value / (double)FIXED_ONE; }
+static inline Fixed fixedMul( Fixed a, Fixed b ) { return (Fixed)(((Sint64)a * b) >> FIXED_SHIFT); }
+static inline Fixed fixedDiv( Fixed a, Fixed b ) { return (Fixed)(((Sint64)a * FIXED_ONE) / b); }
+static inline Fixed fixedAbs( Fixed value )     { return value < 0 ? -value : value; }
+
+extern const double MAX_DELTA_TIME; // Maximum delta time at which the hit test between objects still works, milliseconds
 
 typedef enum
 {
@@ -117,12 +139,20 @@ typedef enum
     SOLID_ALL = SOLID_LEFT | SOLID_RIGHT | SOLID_TOP | SOLID_BOTTOM
 } SolidFlags;
 
+typedef enum
+{
+    THEME_CASTLE = 0,
+    THEME_FOREST,
+    THEME_UNDERGROUND,
+    THEME_COUNT
+} ThemeId;
+
 typedef struct
 {
-    double left;
-    double right;
-    double top;
-    double bottom;
+    Fixed left;
+    Fixed right;
+    Fixed top;
+    Fixed bottom;
 } Borders;
 
 struct Object_s;
@@ -138,7 +168,7 @@ typedef struct
     SDL_Rect sprite; // Sprite rect in the spritesheet, unscaled
     SDL_Rect body;   // Body rect relative to the object (x, y), unscaled
     int solid;
-    double speed;
+    Fixed speed;
     OnInit onInit;
     OnFrame onFrame;
     OnHit onHit;
@@ -165,15 +195,26 @@ typedef struct
 
 typedef struct Object_s
 {
-    ObjectType* type;
+    const ObjectType* type;
     Animation anim;
-    double x;
-    double y;
-    double vx;      // Pixels per second
-    double vy;      // Pixels per second
+    Fixed x;
+    Fixed y;
+    Fixed vx;       // Pixels per second
+    Fixed vy;       // Pixels per second
     int removed;
     int state;
     int data;
+    Uint32 id;                  // Unique in the game, keys the random numbers, see getObjectRandom()
+    Uint32 randomCount;         // Random numbers taken
+    int sleeping;               // See sleepObject()
+    int sleepTime;              // Level time when the object fell asleep
+    int wakeTime;               // Level time to wake at, or 0
+    struct Object_s* nextSleeper; // Next sleeping object in the same cell
+    struct Object_s* nextTimer;   // Next sleeping object in the same timer wheel slot
+    struct Object_s** timerLink;  // Pointer to this object in its timer wheel slot, or NULL
+    struct Object_s* nextInChunk; // Next object in the same chunk, see Level::chunkObjects
+    struct Object_s** chunkLink;  // Pointer to this object in its chunk list, or NULL
+    int chunk;
 } Object;
 
 typedef struct
@@ -183,18 +224,40 @@ typedef struct
     int count;
 } ObjectArray;
 
+// Objects sorted by depth: each type has its own bucket, and the buckets are
+// drawn from the last type to the first one, so the objects with lower type id
+// are drawn on top. The awake objects are kept at the beginning of each bucket,
+// before the sleeping ones.
+typedef struct
+{
+    ObjectArray buckets[TYPE_COUNT];
+    int awake[TYPE_COUNT];
+    int count;
+} ObjectLayers;
+
 // Player inherits Object, so must begin with its fields
 typedef struct
 {
-    ObjectType* type;
+    const ObjectType* type;
     Animation anim;
-    double x;
-    double y;
-    double vx;
-    double vy;
+    Fixed x;
+    Fixed y;
+    Fixed vx;
+    Fixed vy;
     int removed;        // Unused
     int state;          // Unused
     int data;           // Unused
+    Uint32 id;
+    Uint32 randomCount; // Unused
+    int sleeping;       // Unused
+    int sleepTime;      // Unused
+    int wakeTime;       // Unused
+    Object* nextSleeper; // Unused
+    Object* nextTimer;  // Unused
+    Object** timerLink; // Unused
+    Object* nextInChunk; // Unused
+    Object** chunkLink; // Unused
+    int chunk;          // Unused
     int inAir;
     int onLadder;
     int health;
@@ -205,28 +268,123 @@ typedef struct
     ObjectArray items;
 } Player;
 
+// Navigation data of a level, see navigation.h. The arrays have a value per
+// cell, row by row, and are allocated on the first build.
+typedef struct
+{
+    Sint16* spanLeft;       // Leftmost column reachable by walking from the cell
+    Sint16* spanRight;      // Rightmost column reachable by walking from the cell
+    Sint16* fallRow;        // Row to land on when falling from the cell, or -1
+    Sint16* ladderTop;      // Top row of the ladder in the cell, or -1
+    Sint16* ladderBottom;   // Bottom row of the ladder in the cell, or -1
+    int* jumpLeft;          // Cell a jump to the left from the cell lands in, or -1
+    int* jumpRight;         // Cell a jump to the right from the cell lands in, or -1
+    int* spots;             // Standable cells (r * columns + c), row by row
+    int* rowSpots;          // Index of the first spot in each row, rows + 1 values
+    int valid;
+} Navigation;
+
+// Sleeping objects by wake time, see timerwheel.h
+enum
+{
+    TIMER_WHEEL_RESOLUTION = 8, // ms
+    TIMER_WHEEL_LEVELS = 3,
+    TIMER_WHEEL_SLOTS = 64
+};
+
 typedef struct
 {
-    ObjectType* cells[ROW_COUNT][COLUMN_COUNT];
-    ObjectArray objects;
+    Object* slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    int now;    // Wheel ticks
+    int count;
+} TimerWheel;
+
+// The level cells are stored in square chunks. Only the chunks with some
+// content are allocated, the others share one empty chunk, so a large level
+// with a lot of empty space takes little memory, and a cell lookup is still
+// two array reads (see getCell()).
+enum
+{
+    CHUNK_SHIFT = 4,
+    CHUNK_SIZE = 1 << CHUNK_SHIFT, // Cells
+    CHUNK_MASK = CHUNK_SIZE - 1
+};
+
+typedef struct
+{
+    const ObjectType* cells[CHUNK_SIZE][CHUNK_SIZE];
+    Uint8 walls[CHUNK_SIZE][CHUNK_SIZE + 1];    // Count of SOLID_LEFT | SOLID_RIGHT cells in the chunk row before the column
+    Object* sleepers[CHUNK_SIZE][CHUNK_SIZE];   // Sleeping objects by cell, see sleepObject()
+} Chunk;
+
+typedef struct
+{
+    Chunk** chunks;                            // chunkRows * chunkColumns, row by row
+    int* walls;                                // Count of walls in the row before each chunk, rows * chunkColumns
+    int rows;
+    int columns;
+    int chunkRows;
+    int chunkColumns;
+    ObjectLayers objects;
+    Object** chunkObjects;                     // Objects (but the player) by the chunk of their center, for drawing
+    TimerWheel timers;                         // Sleeping objects with wake time
+    ObjectArray waking;                        // Objects to wake in the current tick
+    int time;                                  // Game time of the level, ms
+    Uint32 revision;                           // Incremented when the cells change
+    Navigation navigation;
     int r;
     int c;
-    void (*init)();
+    ThemeId theme;
 } Level;
 
 void ObjectArray_init( ObjectArray* objects );
 void ObjectArray_append( ObjectArray* objects, Object* object );
+void ObjectArray_removeAt( ObjectArray* objects, int i );
 void ObjectArray_free( ObjectArray* objects );
-void ObjectArray_clean( ObjectArray* objects );
-void ObjectArray_sortByDepth( ObjectArray* objects );
 
+void ObjectLayers_init( ObjectLayers* layers );
+void ObjectLayers_insert( ObjectLayers* layers, Object* object );
+void ObjectLayers_removeAt( ObjectLayers* layers, ObjectTypeId typeId, int i );
+void ObjectLayers_sleepAt( ObjectLayers* layers, ObjectTypeId typeId, int i );
+void ObjectLayers_wake( ObjectLayers* layers, Object* object );
+void ObjectLayers_free( ObjectLayers* layers );
+
+Object* allocObject( ObjectTypeId typeId );
+void freeObject( Object* object );
 void createStaticObject( Level* level, ObjectTypeId typeId, int r, int c );
 Object* createObject( Level* level, ObjectTypeId typeId, int r, int c );
+void releaseObject( Object* object );
 void initObject( Object* object, ObjectTypeId typeId );
 void initPlayer( Player* player );
-void initLevel( Level* level );
-void initTypes();
+void initLevel( Level* level, int rows, int columns );
+void freeLevel( Level* level );
+Chunk* getWritableChunk( Level* level, int r, int c );
+void updateObjectChunk( Level* level, Object* object ); // After the object moved
+void removeObjectChunk( Object* object );
+void resetObjectChunks( Level* level );
+int isChunkAllocated( const Chunk* chunk );
+
+// The cell must be within the level
+static inline Chunk* getChunk( const Level* level, int r, int c )
+{
+    return level->chunks[(r >> CHUNK_SHIFT) * level->chunkColumns + (c >> CHUNK_SHIFT)];
+}
+
+static inline const ObjectType* getCell( const Level* level, int r, int c )
+{
+    return getChunk(level, r, c)->cells[r & CHUNK_MASK][c & CHUNK_MASK];
+}
+
+// Count of walls in the row r before the column c, c <= columns
+static inline int countWalls( const Level* level, int r, int c )
+{
+    const int k = c < level->columns ? c : c - 1;
+    const Chunk* chunk = getChunk(level, r, k);
+    return level->walls[r * level->chunkColumns + (k >> CHUNK_SHIFT)] + chunk->walls[r & CHUNK_MASK][(k & CHUNK_MASK) + (c - k)];
+}
 
-extern ObjectType objectTypes[TYPE_COUNT];
+// Generated from types.def and themes.def at build time, see tables.c
+extern const ObjectType objectTypes[TYPE_COUNT];
+extern const SDL_Rect themeSprites[THEME_COUNT][TYPE_COUNT];
 
 #endif